@@ -0,0 +1,96 @@
+/**
+ * CAN MREX object dictionary lookup benchmark
+ *
+ * File:            OdLookupBench.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Times findODEntry(), a binary search over the sorted entries, against the linear scan it replaced, with 8,
+ * 32, 128 and 512 entries in the dictionary (the ones initDefaultOD() registers included). Keys are looked up in a shuffled order so neither side gets a free ride
+ * from the branch predictor, once for entries that exist and once for ones that don't. Build with
+ * -DCMAKE_BUILD_TYPE=Release or the numbers mean nothing.
+ *
+ * Usage: od_lookup_bench [lookups]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "CM.h"
+
+#define BENCH_INDEX     0x3000
+#define BENCH_MAX       512
+#define BENCH_KEYS      4096   // shuffled keys cycled through by every timing loop
+
+static const uint16_t sizes[] = {8, 32, 128, 512};
+static const uint8_t NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]);
+
+static uint8_t vars[BENCH_MAX];
+static ODEntry odStorage[BENCH_MAX + MAX_OD_ENTRIES];
+static uint16_t hitKeys[BENCH_KEYS];
+static uint16_t missKeys[BENCH_KEYS];
+
+// What findODEntry() did before the entries were kept sorted
+static const ODEntry* linearFind(uint16_t index, uint8_t subindex) {
+  const OdNodeState& od = cmNode->od;
+  for (int i = 0; i < od.count; i++) {
+    if (od.entries[i].index == index && od.entries[i].subindex == subindex) return &od.entries[i];
+  }
+  return nullptr;
+}
+
+static double nsPerCall(uint32_t iterations, const std::chrono::steady_clock::time_point& start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Entries are registered at BENCH_INDEX + n, subindex 1, so a key is just n
+template <typename Find>
+static double timeLookups(Find find, const uint16_t* keys, uint32_t lookups, volatile uintptr_t& sink) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < lookups; n++) {
+    sink ^= (uintptr_t)find(BENCH_INDEX + keys[n & (BENCH_KEYS - 1)], 1);
+  }
+  return nsPerCall(lookups, start);
+}
+
+int main(int argc, char** argv) {
+  uint32_t lookups = argc > 1 ? atoi(argv[1]) : 2000000;
+
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, 1);
+  setODStorage(odStorage);
+
+  printf("%u lookups per cell, keys in shuffled order\n\n", (unsigned)lookups);
+  printf("Entries   Linear hit ns  Binary hit ns  Linear miss ns  Binary miss ns\n");
+
+  volatile uintptr_t sink = 0;
+  uint16_t defaults = getODStats().used;  // registered by initCANMREX(), counted towards each size
+  uint16_t registered = 0;
+  uint32_t seed = 12345;
+  int result = 0;
+  for (uint8_t s = 0; s < NUM_SIZES; s++) {
+    // Sizes build on each other, the node keeps the entries from the smaller ones
+    for (; defaults + registered < sizes[s]; registered++) {
+      if (!registerODEntry(BENCH_INDEX + registered, 1, 2, 1, &vars[registered])) {
+        printf("Registering entry %u failed\n", registered);
+        return 1;
+      }
+    }
+    for (uint16_t k = 0; k < BENCH_KEYS; k++) {
+      seed = seed * 1103515245u + 12345u;
+      hitKeys[k] = (uint16_t)((seed >> 8) % registered);
+      missKeys[k] = (uint16_t)(BENCH_MAX + (seed >> 8) % registered);  // past every registered entry
+    }
+    if (findODEntry(BENCH_INDEX + hitKeys[0], 1) != linearFind(BENCH_INDEX + hitKeys[0], 1)) result = 1;
+
+    double linearHit = timeLookups(linearFind, hitKeys, lookups, sink);
+    double binaryHit = timeLookups(findODEntry, hitKeys, lookups, sink);
+    double linearMiss = timeLookups(linearFind, missKeys, lookups, sink);
+    double binaryMiss = timeLookups(findODEntry, missKeys, lookups, sink);
+    printf("%7u  %14.1f  %13.1f  %14.1f  %14.1f\n", getODStats().used, linearHit, binaryHit, linearMiss, binaryMiss);
+  }
+  return result;
+}
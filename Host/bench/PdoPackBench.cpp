@@ -0,0 +1,103 @@
+/**
+ * CAN MREX PDO packing benchmark
+ *
+ * File:            PdoPackBench.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Times packTPDO()/unpackRPDO() for byte-aligned mappings (memcpy per field) against bit-packed ones
+ * (shift/mask into one 64-bit word). Numbers are for the machine it runs on, compare them with each other
+ * rather than with an ESP32.
+ *
+ * Usage: pdo_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "CM.h"
+
+typedef struct {
+  const char* name;
+  uint8_t     count;
+  uint8_t     bits;        // per field, every field in a case has the same width
+  uint16_t    index;       // TX variables at index/1.., RX variables at index + 1/1..
+} BenchCase;
+
+static const BenchCase cases[] = {
+  {"8 x uint8_t, bytes",    8,  8, 0x2100},
+  {"4 x uint16_t, bytes",   4, 16, 0x2200},
+  {"2 x uint32_t, bytes",   2, 32, 0x2300},
+  {"8 x 1 bit flags",       8,  1, 0x2400},
+  {"16 x 4 bit fields",    16,  4, 0x2500},
+  {"64 x 1 bit flags",     64,  1, 0x2600},
+};
+
+static const uint8_t NUM_CASES = sizeof(cases) / sizeof(cases[0]);
+
+static uint8_t txVars[NUM_CASES][64][4];
+static uint8_t rxVars[NUM_CASES][64][4];
+static ODEntry odStorage[2 * 64 * NUM_CASES + 8];
+
+static double nsPerCall(uint32_t iterations, const std::chrono::steady_clock::time_point& start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  uint32_t iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, 1);
+  setODStorage(odStorage);
+  nodeOperatingMode = 0x01;
+
+  printf("%u iterations, CM_PDO_MAX_ENTRIES %u\n\n", (unsigned)iterations, CM_PDO_MAX_ENTRIES);
+  printf("Mapping               Path      Bytes   Pack ns   Unpack ns\n");
+
+  volatile uint8_t sink = 0;
+  for (uint8_t c = 0; c < NUM_CASES; c++) {
+    const BenchCase& bc = cases[c];
+    uint8_t size = (bc.bits + 7) / 8;
+    PdoMapEntry txMap[64], rxMap[64];
+    for (uint8_t i = 0; i < bc.count; i++) {
+      registerODEntry(bc.index, i + 1, 2, size, txVars[c][i]);
+      registerODEntry(bc.index + 1, i + 1, 2, size, rxVars[c][i]);
+      txMap[i] = {bc.index, (uint8_t)(i + 1), bc.bits};
+      rxMap[i] = {(uint16_t)(bc.index + 1), (uint8_t)(i + 1), bc.bits};
+      txVars[c][i][0] = (uint8_t)(i * 37 + 1);
+    }
+
+    // Channel 0 both ways, re-mapped for every case. RX variables are separate so unpacking doesn't mark the TPDO dirty
+    configureTPDO(0, 0x181, 255, 0, 0);
+    configureRPDO(0, 0x201, 255, 0);
+    if (!mapTPDO(0, txMap, bc.count) || !mapRPDO(0, rxMap, bc.count)) {
+      printf("%-20s  mapping rejected (CM_PDO_MAX_ENTRIES too small?)\n", bc.name);
+      continue;
+    }
+
+    uint8_t frame[8] = {0};
+    uint8_t len = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < iterations; n++) {
+      txVars[c][0][0] = (uint8_t)n;  // keep the compiler from hoisting the work out of the loop
+      packTPDO(1, 0, frame, &len);
+      sink ^= frame[0];
+    }
+    double packNs = nsPerCall(iterations, start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < iterations; n++) {
+      frame[0] = (uint8_t)n;
+      unpackRPDO(1, 0, frame, len);
+      sink ^= rxVars[c][0][0];
+    }
+    double unpackNs = nsPerCall(iterations, start);
+
+    printf("%-20s  %-8s  %5u  %8.1f  %10.1f\n", bc.name, cmNode->pdo.tpdoPlan[0].bitPacked ? "bits" : "memcpy",
+           len, packNs, unpackNs);
+  }
+  return sink == 0xFF ? 1 : 0;  // sink only exists to keep the loops
+}
@@ -0,0 +1,199 @@
+/**
+ * CAN MREX SDO throughput benchmark
+ *
+ * File:            SdoBench.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Moves one object between two nodes on the simulated 500 kbit/s bus with each SDO transfer type and reports
+ * bytes per second of simulated time. Expedited is a run of 4 byte requests, segmented and block transfers move
+ * the whole object in one request. Both nodes call handleCAN() once per loop period and the client polls
+ * sdoPoll() there, as a sketch would, so the loop period paces every row the same way.
+ *
+ * Usage: sdo_bench [object bytes] [loop period us]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "TrainSim.h"
+
+#define BENCH_SERVER_ID  1
+#define BENCH_CLIENT_ID  2
+#define BENCH_INDEX      0x2000
+#define BENCH_MAX_BYTES  16384
+#define BENCH_LIMIT_MS   60000   // simulated time before a case is given up on
+
+typedef enum : uint8_t {
+  BENCH_EXPEDITED = 0,
+  BENCH_SEGMENTED,
+  BENCH_BLOCK
+} BenchMode;
+
+typedef struct {
+  const char* name;
+  BenchMode   mode;
+  bool        write;
+  uint8_t     blockSize;   // block transfers only, set on both nodes
+} BenchCase;
+
+static const BenchCase cases[] = {
+  {"Expedited write",        BENCH_EXPEDITED, true,  0},
+  {"Expedited read",         BENCH_EXPEDITED, false, 0},
+  {"Segmented write",        BENCH_SEGMENTED, true,  0},
+  {"Segmented read",         BENCH_SEGMENTED, false, 0},
+  {"Block write, 4 seg",     BENCH_BLOCK,     true,  4},
+  {"Block read, 4 seg",      BENCH_BLOCK,     false, 4},
+  {"Block write, 16 seg",    BENCH_BLOCK,     true,  16},
+  {"Block read, 16 seg",     BENCH_BLOCK,     false, 16},
+  {"Block write, 127 seg",   BENCH_BLOCK,     true,  127},
+  {"Block read, 127 seg",    BENCH_BLOCK,     false, 127},
+};
+
+static const uint8_t NUM_CASES = sizeof(cases) / sizeof(cases[0]);
+
+// Subindex 1 is the whole object, subindex 2 the 4 byte word the expedited cases go through
+static uint8_t serverObject[BENCH_MAX_BYTES];
+static uint32_t serverWord;
+static uint8_t clientObject[BENCH_MAX_BYTES];
+
+static const BenchCase* current;
+static uint16_t objectBytes;
+static uint16_t bytesDone;
+static uint32_t requests;
+static SdoHandle handle;
+static bool failed;
+static bool started;
+static uint32_t startUs;
+static uint32_t endUs;
+
+static void serverSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  registerODEntry(BENCH_INDEX, 1, 2, objectBytes, serverObject);
+  registerODEntry(BENCH_INDEX, 2, 2, 4, &serverWord);
+  if (current->mode == BENCH_BLOCK) setSDOBlockSize(current->blockSize);
+  nodeOperatingMode = 0x01;
+}
+
+// Expedited requests move the object 4 bytes at a time through the word, bytesDone only moves on once the
+// client has the response
+static void serverLoop(uint8_t nodeID) {
+  bool expedited = current->mode == BENCH_EXPEDITED && bytesDone < objectBytes;
+  if (expedited && !current->write) memcpy(&serverWord, serverObject + bytesDone, 4);
+  handleCAN(nodeID);
+  if (expedited && current->write) memcpy(serverObject + bytesDone, &serverWord, 4);
+}
+
+static void clientSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  if (current->mode == BENCH_BLOCK) setSDOBlockSize(current->blockSize);
+  nodeOperatingMode = 0x01;
+}
+
+static SdoHandle startTransfer(uint8_t nodeID) {
+  const BenchCase& bc = *current;
+  switch (bc.mode) {
+    case BENCH_EXPEDITED:
+      if (bc.write) return sdoWriteAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 2, 4, clientObject + bytesDone);
+      return sdoReadAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 2);
+    case BENCH_SEGMENTED:
+      if (bc.write) return sdoWriteAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 1, objectBytes, clientObject);
+      return sdoReadBufferAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 1, clientObject, objectBytes);
+    case BENCH_BLOCK:
+      if (bc.write) return sdoBlockWriteAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 1, objectBytes, clientObject);
+      return sdoBlockReadAsync(nodeID, BENCH_SERVER_ID, BENCH_INDEX, 1, clientObject, objectBytes);
+  }
+  return SDO_INVALID_HANDLE;
+}
+
+static void clientLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (failed || bytesDone >= objectBytes) return;
+
+  if (handle != SDO_INVALID_HANDLE) {
+    uint32_t value = 0;
+    SdoStatus status = sdoPoll(handle, &value);
+    if (status == SDO_PENDING) return;
+    handle = SDO_INVALID_HANDLE;
+    if (status != SDO_DONE) {
+      failed = true;
+      return;
+    }
+    if (current->mode == BENCH_EXPEDITED) {
+      if (!current->write) memcpy(clientObject + bytesDone, &value, 4);
+      bytesDone += 4;
+    } else {
+      bytesDone = objectBytes;
+    }
+    if (bytesDone >= objectBytes) {
+      endUs = micros();
+      return;
+    }
+  }
+
+  if (!started) {
+    started = true;
+    startUs = micros();
+  }
+  handle = startTransfer(nodeID);
+  requests++;
+  if (handle == SDO_INVALID_HANDLE) failed = true;
+}
+
+int main(int argc, char** argv) {
+  uint32_t bytes = argc > 1 ? atoi(argv[1]) : 4096;
+  uint32_t loopUs = argc > 2 ? atoi(argv[2]) : 250;
+  if (bytes < 4 || bytes > BENCH_MAX_BYTES || bytes % 4 != 0) {
+    printf("Object size must be a multiple of 4 between 4 and %u bytes\n", BENCH_MAX_BYTES);
+    return 1;
+  }
+  objectBytes = bytes;
+
+  // 7 data bytes per 8 byte frame is the most any SDO transfer can carry
+  printf("%u byte object, %lu us loop period, %u kbit/s\n", objectBytes, (unsigned long)loopUs,
+         CAN_BITRATE_DEFAULT / 1000);
+  printf("Bus limit for 7 data bytes a frame: %.0f-%.0f B/s\n\n", 7.0 * CAN_BITRATE_DEFAULT / canFrameBitsMax(8),
+         7.0 * CAN_BITRATE_DEFAULT / canFrameBitsMin(8));
+  printf("Transfer              Requests  Frames      ms     Bytes/s  Load %%  Data\n");
+
+  int result = 0;
+  for (uint8_t c = 0; c < NUM_CASES; c++) {
+    current = &cases[c];
+    bytesDone = 0;
+    requests = 0;
+    handle = SDO_INVALID_HANDLE;
+    failed = false;
+    started = false;
+    startUs = 0;
+    endUs = 0;
+    for (uint16_t i = 0; i < objectBytes; i++) {
+      serverObject[i] = (uint8_t)(i * 31 + c);
+      clientObject[i] = (uint8_t)(i * 17 + 5);
+    }
+
+    simReset();
+    simAddNode({"Server", BENCH_SERVER_ID, serverSetup, serverLoop, loopUs, 0});
+    simAddNode({"Client", BENCH_CLIENT_ID, clientSetup, clientLoop, loopUs, 0});
+    uint32_t elapsedMs = 0;
+    while (!failed && bytesDone < objectBytes && elapsedMs < BENCH_LIMIT_MS) {
+      simRun(10);
+      elapsedMs += 10;
+    }
+
+    if (failed || bytesDone < objectBytes) {
+      printf("%-20s  failed after %u of %u bytes\n", current->name, bytesDone, objectBytes);
+      result = 1;
+      continue;
+    }
+    bool match = memcmp(serverObject, clientObject, objectBytes) == 0;
+    if (!match) result = 1;
+    SimBusStats bus = simBusStats();
+    double seconds = (endUs - startUs) / 1e6;
+    printf("%-20s  %8lu  %6lu  %6.1f  %10.0f  %6.1f  %s\n", current->name, (unsigned long)requests,
+           (unsigned long)bus.frames, seconds * 1000, objectBytes / seconds, bus.load * 100.0f,
+           match ? "ok" : "MISMATCH");
+  }
+  return result;
+}
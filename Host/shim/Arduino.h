@@ -0,0 +1,72 @@
+/**
+ * CAN MREX Host shim: Arduino core
+ *
+ * File:            Arduino.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Just enough of Arduino.h and FreeRTOS for the files in main/ to build on Linux.
+ */
+
+#ifndef CM_HOST_ARDUINO_H
+#define CM_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+// --- ESP-IDF error codes ---
+typedef int esp_err_t;
+#define ESP_OK                0
+#define ESP_FAIL              -1
+#define ESP_ERR_INVALID_ARG   0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT       0x107
+
+// --- FreeRTOS ---
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY     ((TickType_t)0xFFFFFFFFu)
+#define pdPASS            1
+#define pdFAIL            0
+
+// There are no tasks on the host, the stack falls back to polling (CM_USE_RX_TASK is 0 in the host build)
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack, void* arg,
+                                   int priority, TaskHandle_t* handle, int core);
+void vTaskDelay(TickType_t ticks);
+
+// --- Timing ---
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+inline void yield() {}
+
+// --- Serial ---
+class HostSerial {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void print(const char* s);
+  void print(char c);
+  void print(long v, int base = 10);
+  void print(unsigned long v, int base = 10);
+  void print(int v, int base = 10) { print((long)v, base); }
+  void print(unsigned int v, int base = 10) { print((unsigned long)v, base); }
+  void print(double v, int digits = 2);
+  void println() { print("\n"); }
+  template <typename T> void println(T v) { print(v); println(); }
+  template <typename T> void println(T v, int fmt) { print(v, fmt); println(); }
+};
+
+extern HostSerial Serial;
+
+#define HEX 16
+#define DEC 10
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * CAN MREX Host shim: Arduino core
+ *
+ * File:            HostArduino.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "Arduino.h"
+#include "HostBus.h"
+#include <stdio.h>
+#include <chrono>
+
+HostSerial Serial;
+
+static bool serialEnabled = false;
+static bool clockManual = false;
+static uint64_t manualMicros = 0;
+static const auto clockStart = std::chrono::steady_clock::now();
+
+// --- Clock ---
+void hostClockSetManual(bool manual) {
+  manualMicros = hostClockMicros();
+  clockManual = manual;
+}
+
+void hostClockSetMicros(uint64_t us) {
+  manualMicros = us;
+}
+
+void hostClockAdvanceMicros(uint64_t us) {
+  manualMicros += us;
+}
+
+uint64_t hostClockMicros() {
+  if (clockManual) return manualMicros;
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+uint32_t millis() {
+  return (uint32_t)(hostClockMicros() / 1000);
+}
+
+uint32_t micros() {
+  return (uint32_t)hostClockMicros();
+}
+
+void delay(uint32_t ms) {
+  if (clockManual) {
+    manualMicros += (uint64_t)ms * 1000;
+    return;
+  }
+  uint64_t end = hostClockMicros() + (uint64_t)ms * 1000;
+  while (hostClockMicros() < end) {}
+}
+
+// --- FreeRTOS ---
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack, void* arg,
+                                   int priority, TaskHandle_t* handle, int core) {
+  (void)task; (void)name; (void)stack; (void)arg; (void)priority; (void)core;
+  if (handle != nullptr) *handle = nullptr;
+  return pdFAIL;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  delay(ticks);
+}
+
+// --- Serial ---
+void hostSerialEnable(bool enabled) {
+  serialEnabled = enabled;
+}
+
+void HostSerial::print(const char* s) {
+  if (serialEnabled) fputs(s, stdout);
+}
+
+void HostSerial::print(char c) {
+  if (serialEnabled) fputc(c, stdout);
+}
+
+void HostSerial::print(long v, int base) {
+  if (serialEnabled) printf(base == HEX ? "%lX" : "%ld", v);
+}
+
+void HostSerial::print(unsigned long v, int base) {
+  if (serialEnabled) printf(base == HEX ? "%lX" : "%lu", v);
+}
+
+void HostSerial::print(double v, int digits) {
+  if (serialEnabled) printf("%.*f", digits, v);
+}
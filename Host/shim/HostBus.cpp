@@ -0,0 +1,332 @@
+/**
+ * CAN MREX Host virtual bus
+ *
+ * File:            HostBus.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "HostBus.h"
+#include <deque>
+
+#ifdef CM_HOST_SOCKETCAN
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#endif
+
+// A frame waiting in a port's TX queue and the bus time it was queued at
+typedef struct {
+  twai_message_t msg;
+  uint64_t queuedUs;
+} HostTxFrame;
+
+// One TWAI controller per port
+typedef struct {
+  bool installed;
+  bool running;
+  bool inFlight;   // a frame taken by hostBusBeginTransfer() still occupies the controller's TX buffer
+  twai_general_config_t g;
+  twai_filter_config_t f;
+  std::deque<HostTxFrame> tx;
+  std::deque<twai_message_t> rx;
+  uint32_t rxMissed;
+} HostPort;
+
+static HostPort ports[HOST_BUS_MAX_PORTS];
+static uint8_t portCount = 0;
+static uint8_t currentPort = 0;
+static HostBusObserver busObserver = nullptr;
+static void* busObserverArg = nullptr;
+
+#ifdef CM_HOST_SOCKETCAN
+static int canSocket = -1;
+static void socketCANWrite(const twai_message_t& msg);
+static void socketCANPoll();
+#endif
+
+// Same matching as the TWAI acceptance filter for standard frames (mask bit 1 = don't care)
+static bool filterAccepts(const twai_filter_config_t& f, const twai_message_t& msg) {
+  uint32_t id = msg.identifier & 0x7FF;
+  uint32_t rtr = msg.rtr ? 1 : 0;
+  uint32_t b0 = msg.data_length_code > 0 ? msg.data[0] : 0;
+  uint32_t b1 = msg.data_length_code > 1 ? msg.data[1] : 0;
+  if (f.single_filter) {
+    uint32_t word = (id << 21) | (rtr << 20) | (b0 << 8) | b1;
+    return ((word ^ f.acceptance_code) & ~f.acceptance_mask & 0xFFF0FFFFu) == 0;
+  }
+  uint32_t word1 = (id << 21) | (rtr << 20) | ((b0 >> 4) << 16) | (b0 & 0x0F);
+  uint32_t word2 = (id << 5) | (rtr << 4);
+  bool f1 = ((word1 ^ f.acceptance_code) & ~f.acceptance_mask & 0xFFFF000Fu) == 0;
+  bool f2 = ((word2 ^ f.acceptance_code) & ~f.acceptance_mask & 0x0000FFF0u) == 0;
+  return f1 || f2;
+}
+
+static void deliver(const twai_message_t& msg, uint8_t fromPort) {
+  for (uint8_t p = 0; p < portCount; p++) {
+    HostPort& port = ports[p];
+    if (p == fromPort || !port.running) continue;
+    if (!filterAccepts(port.f, msg)) continue;
+    if (port.rx.size() >= port.g.rx_queue_len) {
+      port.rxMissed++;
+      continue;
+    }
+    port.rx.push_back(msg);
+  }
+  if (busObserver != nullptr) busObserver(msg, fromPort, busObserverArg);
+}
+
+// --- Bus ---
+void hostBusReset() {
+  for (uint8_t p = 0; p < HOST_BUS_MAX_PORTS; p++) {
+    ports[p].installed = false;
+    ports[p].running = false;
+    ports[p].inFlight = false;
+    ports[p].tx.clear();
+    ports[p].rx.clear();
+    ports[p].rxMissed = 0;
+  }
+  portCount = 0;
+  currentPort = 0;
+}
+
+uint8_t hostBusAddPort() {
+  if (portCount >= HOST_BUS_MAX_PORTS) return HOST_BUS_NO_PORT;
+  return portCount++;
+}
+
+void hostBusSelectPort(uint8_t port) {
+  if (port < HOST_BUS_MAX_PORTS) currentPort = port;
+}
+
+uint8_t hostBusCurrentPort() {
+  return currentPort;
+}
+
+uint8_t hostBusPortCount() {
+  return portCount;
+}
+
+bool hostBusNextWinner(twai_message_t* msg, uint8_t* port) {
+  uint8_t winner = HOST_BUS_NO_PORT;
+  for (uint8_t p = 0; p < portCount; p++) {
+    if (!ports[p].running || ports[p].tx.empty()) continue;
+    if (winner == HOST_BUS_NO_PORT || ports[p].tx.front().msg.identifier < ports[winner].tx.front().msg.identifier) winner = p;
+  }
+  if (winner == HOST_BUS_NO_PORT) return false;
+  if (msg != nullptr) *msg = ports[winner].tx.front().msg;
+  if (port != nullptr) *port = winner;
+  return true;
+}
+
+bool hostBusPending() {
+  return hostBusNextWinner(nullptr, nullptr);
+}
+
+bool hostBusTransferOne() {
+#ifdef CM_HOST_SOCKETCAN
+  socketCANPoll();
+#endif
+  twai_message_t msg;
+  uint8_t port;
+  if (!hostBusNextWinner(&msg, &port)) return false;
+  ports[port].tx.pop_front();
+  deliver(msg, port);
+#ifdef CM_HOST_SOCKETCAN
+  socketCANWrite(msg);
+#endif
+  return true;
+}
+
+bool hostBusBeginTransfer(twai_message_t* msg, uint8_t* port, uint64_t* queuedUs) {
+#ifdef CM_HOST_SOCKETCAN
+  socketCANPoll();
+#endif
+  uint8_t winner;
+  if (!hostBusNextWinner(msg, &winner)) return false;
+  if (queuedUs != nullptr) *queuedUs = ports[winner].tx.front().queuedUs;
+  ports[winner].tx.pop_front();
+  ports[winner].inFlight = true;
+  if (port != nullptr) *port = winner;
+  return true;
+}
+
+void hostBusFinishTransfer(const twai_message_t& msg, uint8_t port) {
+  if (port < HOST_BUS_MAX_PORTS) ports[port].inFlight = false;
+  deliver(msg, port);
+#ifdef CM_HOST_SOCKETCAN
+  socketCANWrite(msg);
+#endif
+}
+
+uint32_t hostBusRun(uint32_t maxFrames) {
+  uint32_t count = 0;
+  while (count < maxFrames && hostBusTransferOne()) count++;
+  return count;
+}
+
+void hostBusInject(const twai_message_t& msg) {
+  deliver(msg, HOST_BUS_NO_PORT);
+}
+
+void hostBusSetObserver(HostBusObserver observer, void* arg) {
+  busObserver = observer;
+  busObserverArg = arg;
+}
+
+// --- TWAI driver on the selected port ---
+esp_err_t twai_driver_install(const twai_general_config_t* g_config, const twai_timing_config_t* t_config,
+                              const twai_filter_config_t* f_config) {
+  (void)t_config;
+  HostPort& port = ports[currentPort];
+  if (port.installed) return ESP_ERR_INVALID_STATE;
+  if (currentPort >= portCount) portCount = currentPort + 1; // single node programs never call hostBusAddPort()
+  port.installed = true;
+  port.running = false;
+  port.inFlight = false;
+  port.g = *g_config;
+  port.f = *f_config;
+  port.tx.clear();
+  port.rx.clear();
+  return ESP_OK;
+}
+
+esp_err_t twai_driver_uninstall() {
+  HostPort& port = ports[currentPort];
+  if (!port.installed || port.running) return ESP_ERR_INVALID_STATE;
+  port.installed = false;
+  port.tx.clear();
+  port.rx.clear();
+  return ESP_OK;
+}
+
+esp_err_t twai_start() {
+  HostPort& port = ports[currentPort];
+  if (!port.installed || port.running) return ESP_ERR_INVALID_STATE;
+  port.running = true;
+  return ESP_OK;
+}
+
+esp_err_t twai_stop() {
+  HostPort& port = ports[currentPort];
+  if (!port.running) return ESP_ERR_INVALID_STATE;
+  port.running = false;
+  port.tx.clear();
+  return ESP_OK;
+}
+
+// Never waits: on the host nothing else can free space while the caller is blocked
+esp_err_t twai_transmit(const twai_message_t* message, TickType_t ticks_to_wait) {
+  (void)ticks_to_wait;
+  HostPort& port = ports[currentPort];
+  if (!port.running) return ESP_ERR_INVALID_STATE;
+  if (port.tx.size() + (port.inFlight ? 1 : 0) >= port.g.tx_queue_len + 1) return ESP_ERR_TIMEOUT; // queue plus the controller's TX buffer
+  port.tx.push_back({*message, hostClockMicros()});
+  return ESP_OK;
+}
+
+esp_err_t twai_receive(twai_message_t* message, TickType_t ticks_to_wait) {
+  (void)ticks_to_wait;
+  HostPort& port = ports[currentPort];
+  if (!port.installed) return ESP_ERR_INVALID_STATE;
+#ifdef CM_HOST_SOCKETCAN
+  socketCANPoll();
+#endif
+  if (port.rx.empty()) return ESP_ERR_TIMEOUT;
+  *message = port.rx.front();
+  port.rx.pop_front();
+  return ESP_OK;
+}
+
+esp_err_t twai_get_status_info(twai_status_info_t* status_info) {
+  HostPort& port = ports[currentPort];
+  if (!port.installed) return ESP_ERR_INVALID_STATE;
+  memset(status_info, 0, sizeof(*status_info));
+  status_info->state = port.running ? TWAI_STATE_RUNNING : TWAI_STATE_STOPPED;
+  status_info->msgs_to_tx = port.tx.size() + (port.inFlight ? 1 : 0);
+  status_info->msgs_to_rx = port.rx.size();
+  status_info->rx_missed_count = port.rxMissed;
+  return ESP_OK;
+}
+
+esp_err_t twai_reconfigure_alerts(uint32_t alerts_enabled, uint32_t* current_alerts) {
+  (void)alerts_enabled;
+  if (current_alerts != nullptr) *current_alerts = 0;
+  return ESP_OK;
+}
+
+// --- SocketCAN ---
+#ifdef CM_HOST_SOCKETCAN
+bool hostBusOpenSocketCAN(const char* ifname) {
+  hostBusCloseSocketCAN();
+  int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (s < 0) return false;
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  struct sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  if (ioctl(s, SIOCGIFINDEX, &ifr) < 0) {
+    close(s);
+    return false;
+  }
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(s);
+    return false;
+  }
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+  canSocket = s;
+  return true;
+}
+
+void hostBusCloseSocketCAN() {
+  if (canSocket >= 0) close(canSocket);
+  canSocket = -1;
+}
+
+static void socketCANWrite(const twai_message_t& msg) {
+  if (canSocket < 0) return;
+  struct can_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = msg.identifier & (msg.extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+  if (msg.extd) frame.can_id |= CAN_EFF_FLAG;
+  if (msg.rtr) frame.can_id |= CAN_RTR_FLAG;
+  frame.can_dlc = msg.data_length_code > 8 ? 8 : msg.data_length_code;
+  memcpy(frame.data, msg.data, frame.can_dlc);
+  if (write(canSocket, &frame, sizeof(frame)) < 0) {
+    // interface gone or its queue is full, the frame is lost like on a real bus error
+  }
+}
+
+static void socketCANPoll() {
+  if (canSocket < 0) return;
+  struct can_frame frame;
+  while (read(canSocket, &frame, sizeof(frame)) == (ssize_t)sizeof(frame)) {
+    twai_message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.extd = (frame.can_id & CAN_EFF_FLAG) ? 1 : 0;
+    msg.rtr = (frame.can_id & CAN_RTR_FLAG) ? 1 : 0;
+    msg.identifier = frame.can_id & (msg.extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+    msg.data_length_code = frame.can_dlc;
+    memcpy(msg.data, frame.data, frame.can_dlc > 8 ? 8 : frame.can_dlc);
+    deliver(msg, HOST_BUS_NO_PORT);
+  }
+}
+#else
+bool hostBusOpenSocketCAN(const char* ifname) {
+  (void)ifname;
+  return false;
+}
+
+void hostBusCloseSocketCAN() {}
+#endif
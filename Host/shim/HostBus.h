@@ -0,0 +1,62 @@
+/**
+ * CAN MREX Host virtual bus
+ *
+ * File:            HostBus.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * In-process CAN bus for running main/ on Linux. Every node gets a port (its own TWAI controller);
+ * twai_* calls act on the selected port. Frames are exchanged in CAN arbitration order: each round the
+ * lowest COB-ID at the head of any port's transmit queue wins and is delivered to every other port
+ * whose acceptance filter matches.
+ */
+
+#ifndef CM_HOST_BUS_H
+#define CM_HOST_BUS_H
+
+#include "driver/twai.h"
+
+#define HOST_BUS_MAX_PORTS 32
+#define HOST_BUS_NO_PORT   0xFF  // frames injected from outside the bus
+
+// Called for every frame that wins arbitration, fromPort is HOST_BUS_NO_PORT for injected frames
+typedef void (*HostBusObserver)(const twai_message_t& msg, uint8_t fromPort, void* arg);
+
+// --- Bus ---
+void hostBusReset();
+uint8_t hostBusAddPort();                 // returns HOST_BUS_NO_PORT when full
+void hostBusSelectPort(uint8_t port);     // twai_* calls act on this port
+uint8_t hostBusCurrentPort();
+uint8_t hostBusPortCount();
+bool hostBusPending();                                       // any port has a frame waiting to go out
+bool hostBusNextWinner(twai_message_t* msg, uint8_t* port);  // frame that would win the next arbitration round
+bool hostBusTransferOne();                                   // runs one arbitration round
+uint32_t hostBusRun(uint32_t maxFrames = 0xFFFFFFFFu);       // rounds until idle, returns frames transferred
+void hostBusInject(const twai_message_t& msg);               // frame from a test script or an external bus
+
+// Timed transfers for the simulator: Begin takes the arbitration winner off its port (queuedUs is when it was
+// handed to twai_transmit), Finish delivers it once its bits have gone out. The frame keeps the sender's TX
+// buffer busy in between
+bool hostBusBeginTransfer(twai_message_t* msg, uint8_t* port, uint64_t* queuedUs);
+void hostBusFinishTransfer(const twai_message_t& msg, uint8_t port);
+void hostBusSetObserver(HostBusObserver observer, void* arg);
+
+// --- Clock ---
+// Real time by default, manual mode lets simulations and tests drive millis()/micros()
+void hostClockSetManual(bool manual);
+void hostClockSetMicros(uint64_t us);
+void hostClockAdvanceMicros(uint64_t us);
+uint64_t hostClockMicros();
+
+// --- Serial output from the stack (off by default) ---
+void hostSerialEnable(bool enabled);
+
+// --- SocketCAN (vcan/can) backend, only when built with CM_HOST_SOCKETCAN ---
+// Frames that win arbitration are written to the interface and frames read from it are injected
+bool hostBusOpenSocketCAN(const char* ifname);
+void hostBusCloseSocketCAN();
+
+#endif
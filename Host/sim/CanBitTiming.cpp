@@ -0,0 +1,85 @@
+/**
+ * CAN MREX Simulator frame timing
+ *
+ * File:            CanBitTiming.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "CanBitTiming.h"
+
+// Longest stuffed section: SOF + 29 bit ID + SRR/IDE/RTR/r1/r0 + DLC + 64 data bits + 15 CRC bits
+#define CAN_MAX_STUFFED_BITS 128
+
+uint16_t canCrc15(const uint8_t* bits, uint16_t count) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    bool next = bits[i] ^ ((crc >> 14) & 1);
+    crc = (crc << 1) & 0x7FFF;
+    if (next) crc ^= 0x4599;
+  }
+  return crc;
+}
+
+static void pushBits(uint8_t* bits, uint16_t& n, uint32_t value, uint8_t width) {
+  for (int8_t b = width - 1; b >= 0; b--) bits[n++] = (value >> b) & 1;
+}
+
+uint16_t canFrameBits(const twai_message_t& msg) {
+  uint8_t bits[CAN_MAX_STUFFED_BITS];
+  uint16_t n = 0;
+  uint8_t dlc = msg.data_length_code > 8 ? 8 : msg.data_length_code;
+  uint8_t dataBytes = msg.rtr ? 0 : dlc;
+
+  bits[n++] = 0; // SOF
+  if (msg.extd) {
+    pushBits(bits, n, (msg.identifier >> 18) & 0x7FF, 11);
+    bits[n++] = 1;                              // SRR
+    bits[n++] = 1;                              // IDE
+    pushBits(bits, n, msg.identifier & 0x3FFFF, 18);
+    bits[n++] = msg.rtr ? 1 : 0;
+    bits[n++] = 0;                              // r1
+    bits[n++] = 0;                              // r0
+  } else {
+    pushBits(bits, n, msg.identifier & 0x7FF, 11);
+    bits[n++] = msg.rtr ? 1 : 0;
+    bits[n++] = 0;                              // IDE
+    bits[n++] = 0;                              // r0
+  }
+  pushBits(bits, n, msg.data_length_code & 0x0F, 4);
+  for (uint8_t i = 0; i < dataBytes; i++) pushBits(bits, n, msg.data[i], 8);
+  pushBits(bits, n, canCrc15(bits, n), 15);
+
+  // A stuff bit of the opposite level goes in after every 5 equal bits, up to and including the CRC,
+  // and starts the next run
+  uint16_t stuffBits = 0;
+  uint8_t last = 2;
+  uint8_t run = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    if (bits[i] == last) run++;
+    else { last = bits[i]; run = 1; }
+    if (run == 5) {
+      stuffBits++;
+      last = !last;
+      run = 1;
+    }
+  }
+
+  // CRC delimiter, ACK slot, ACK delimiter and EOF are never stuffed
+  return n + stuffBits + 1 + 2 + 7 + CAN_IFS_BITS;
+}
+
+uint16_t canFrameBitsMin(uint8_t dlc) {
+  if (dlc > 8) dlc = 8;
+  return 34 + 8 * dlc + 10 + CAN_IFS_BITS;
+}
+
+// Worst case stuffing for a standard frame: one stuff bit every 4 bits after the first 5 (Davis et al. 2007)
+uint16_t canFrameBitsMax(uint8_t dlc) {
+  if (dlc > 8) dlc = 8;
+  return canFrameBitsMin(dlc) + (34 + 8 * dlc - 1) / 4;
+}
@@ -0,0 +1,34 @@
+/**
+ * CAN MREX Simulator frame timing
+ *
+ * File:            CanBitTiming.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Exact on-wire length of classic CAN frames, used by the train simulator to work out bus occupancy.
+ */
+
+#ifndef CAN_BIT_TIMING_H
+#define CAN_BIT_TIMING_H
+
+#include <stdint.h>
+#include "driver/twai.h"
+
+#define CAN_BITRATE_DEFAULT 500000u   // TWAI_TIMING_CONFIG_500KBITS() in initCANMREX()
+#define CAN_IFS_BITS        3u        // intermission, the bus is not free for the next SOF until it has passed
+
+// CRC-15 of the bits from SOF to the end of the data field (polynomial 0x4599)
+uint16_t canCrc15(const uint8_t* bits, uint16_t count);
+
+// Bits a frame occupies on the bus: SOF to EOF with the stuff bits this payload actually needs, plus the
+// intermission. Handles standard and extended identifiers and remote frames
+uint16_t canFrameBits(const twai_message_t& msg);
+
+// Bits without stuffing and the worst case with the most stuff bits possible for that DLC (standard IDs)
+uint16_t canFrameBitsMin(uint8_t dlc);
+uint16_t canFrameBitsMax(uint8_t dlc);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * CAN MREX network configuration scenario
+ *
+ * File:            ConfigScenario.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * One client configures 16 pre-operational nodes over SDO at start-up, as a master would: TPDO1 is disabled,
+ * remapped, given an inhibit time and event timer and enabled again, and two application parameters are
+ * written. Requests to one node always go one after the other. The concurrent run keeps one request in flight
+ * to every node at once using the client's transfer slots, the serial run configures one node after the other.
+ * Both report the simulated time from the first request to the last response, and the servers' resulting
+ * configuration is checked. The client only starts a request while the SDO transmit queue has room
+ * (getCANTxSpace()), 16 at once would not fit in it.
+ *
+ * Usage: config_sim [loop_us]
+ */
+
+#include <stdlib.h>
+#include "TrainSim.h"
+
+#define CONFIG_SERVERS    16
+#define CONFIG_CLIENT_ID  0x20
+#define CONFIG_PARAM      0x2100
+#define CONFIG_LIMIT_MS   20000   // simulated time before a run is given up on
+
+// One SDO download, value is worked out for the target node
+typedef struct {
+  uint16_t index;
+  uint8_t  subindex;
+  uint8_t  size;
+  uint32_t (*value)(uint8_t nodeID);
+} ConfigStep;
+
+static uint32_t tpdoDisabled(uint8_t nodeID) { return 0x80000000u | (0x180 + nodeID); }
+static uint32_t tpdoEnabled(uint8_t nodeID) { return 0x180 + nodeID; }
+static uint32_t zero(uint8_t nodeID) { return 0; }
+static uint32_t mapParam1(uint8_t nodeID) { return ((uint32_t)CONFIG_PARAM << 16) | (1 << 8) | 32; }
+static uint32_t mapParam2(uint8_t nodeID) { return ((uint32_t)CONFIG_PARAM << 16) | (2 << 8) | 16; }
+static uint32_t twoEntries(uint8_t nodeID) { return 2; }
+static uint32_t inhibit(uint8_t nodeID) { return 50; }        // 5 ms in 100 µs units
+static uint32_t eventTimer(uint8_t nodeID) { return 100; }    // ms
+static uint32_t gain(uint8_t nodeID) { return 1000 + nodeID; }
+static uint32_t limit(uint8_t nodeID) { return 0x5000u | nodeID; }
+
+static const ConfigStep steps[] = {
+  {0x1800, 1, 4, tpdoDisabled},
+  {0x1A00, 0, 1, zero},
+  {0x1A00, 1, 4, mapParam1},
+  {0x1A00, 2, 4, mapParam2},
+  {0x1A00, 0, 1, twoEntries},
+  {0x1800, 3, 2, inhibit},
+  {0x1800, 5, 2, eventTimer},
+  {CONFIG_PARAM, 3, 4, gain},
+  {CONFIG_PARAM, 4, 4, limit},
+  {0x1800, 1, 4, tpdoEnabled},
+};
+
+static const uint8_t NUM_STEPS = sizeof(steps) / sizeof(steps[0]);
+
+// Server side parameters, sub1 and sub2 are what TPDO1 gets mapped to
+typedef struct {
+  uint32_t measured;
+  uint16_t status;
+  uint32_t gain;
+  uint32_t limit;
+} ServerParams;
+
+static ServerParams params[CONFIG_SERVERS + 1];
+
+// Client side progress through steps[] for each server
+typedef struct {
+  uint8_t   step;
+  SdoHandle handle;
+} TargetState;
+
+static TargetState targets[CONFIG_SERVERS + 1];
+static bool concurrent;
+static uint32_t requests;
+static uint32_t failures;
+static uint8_t targetsDone;
+static uint32_t startUs;
+static uint32_t endUs;
+
+static void serverSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  ServerParams& p = params[nodeID];
+  p = {0x12345678u + nodeID, 0x0100, 0, 0};
+  registerODEntry(CONFIG_PARAM, 1, 2, 4, &p.measured);
+  registerODEntry(CONFIG_PARAM, 2, 2, 2, &p.status);
+  registerODEntry(CONFIG_PARAM, 3, 2, 4, &p.gain);
+  registerODEntry(CONFIG_PARAM, 4, 2, 4, &p.limit);
+  nodeOperatingMode = 0x80;  // pre-operational until the master starts the network
+}
+
+static void serverLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+}
+
+static void clientSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  nodeOperatingMode = 0x80;
+}
+
+// Moves one target on when its request finishes and starts its next one. Returns false while it is busy
+static bool advanceTarget(uint8_t clientID, uint8_t target) {
+  TargetState& t = targets[target];
+  if (t.step >= NUM_STEPS) return true;
+  if (t.handle != SDO_INVALID_HANDLE) {
+    SdoStatus status = sdoPoll(t.handle);
+    if (status == SDO_PENDING) return false;
+    if (status != SDO_DONE) failures++;
+    t.handle = SDO_INVALID_HANDLE;
+    if (++t.step >= NUM_STEPS) {
+      targetsDone++;
+      endUs = micros();
+      return true;
+    }
+  }
+  // A full SDO transmit queue would fail the request and send an EMCY, wait for room instead
+  if (getCANTxSpace(CAN_TX_SDO) == 0) return false;
+  const ConfigStep& s = steps[t.step];
+  uint32_t value = s.value(target);
+  t.handle = sdoWriteAsync(clientID, target, s.index, s.subindex, s.size, &value);  // expedited, value is copied
+  if (t.handle == SDO_INVALID_HANDLE) return false;  // no free slot yet, try again next loop
+  requests++;
+  return false;
+}
+
+static void clientLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (startUs == 0) startUs = micros();
+  for (uint8_t target = 1; target <= CONFIG_SERVERS; target++) {
+    if (!advanceTarget(nodeID, target) && !concurrent) break;
+  }
+}
+
+// Reads the servers' PDO objects back through their own nodes and compares them with what was written
+static uint32_t checkServers() {
+  uint32_t wrong = 0;
+  for (uint8_t i = 0; i < simNodeCount(); i++) {
+    uint8_t nodeID = simNodeConfig(i)->nodeID;
+    if (nodeID > CONFIG_SERVERS) continue;
+    cmSelectNode(simNode(i));
+    for (uint8_t s = 0; s < NUM_STEPS; s++) {
+      const ConfigStep& step = steps[s];
+      if (step.index == 0x1A00 && step.subindex == 0) continue;  // written twice, checked through the last one
+      uint32_t value = 0;
+      uint8_t size = 0;
+      bool ok = step.index == CONFIG_PARAM ? true : readPDOObject(step.index, step.subindex, &value, &size);
+      if (step.index == CONFIG_PARAM) value = step.subindex == 3 ? params[nodeID].gain : params[nodeID].limit;
+      if (step.index == 0x1800 && step.subindex == 1) ok = ok && value == tpdoEnabled(nodeID);
+      else ok = ok && value == step.value(nodeID);
+      if (!ok) wrong++;
+    }
+    uint32_t count = 0;
+    uint8_t size = 0;
+    if (!readPDOObject(0x1A00, 0, &count, &size) || count != 2) wrong++;
+  }
+  cmSelectNode(nullptr);
+  return wrong;
+}
+
+static bool runConfig(bool isConcurrent, uint32_t loopUs) {
+  concurrent = isConcurrent;
+  memset(targets, 0, sizeof(targets));
+  requests = 0;
+  failures = 0;
+  targetsDone = 0;
+  startUs = 0;
+  endUs = 0;
+
+  simReset();
+  char names[CONFIG_SERVERS + 1][8];
+  for (uint8_t id = 1; id <= CONFIG_SERVERS; id++) {
+    snprintf(names[id], sizeof(names[id]), "Node%u", id);
+    simAddNode({names[id], id, serverSetup, serverLoop, loopUs, 0});
+  }
+  simAddNode({"Client", CONFIG_CLIENT_ID, clientSetup, clientLoop, loopUs, 10000});  // after the others are listening
+  for (uint32_t ms = 0; targetsDone < CONFIG_SERVERS && ms < CONFIG_LIMIT_MS; ms += 10) simRun(10);
+
+  uint32_t wrong = checkServers();
+  SimBusStats bus = simBusStats();
+  bool done = targetsDone == CONFIG_SERVERS;
+  printf("%-10s  %8lu  %6lu  %8.1f  %6.1f  %6lu  %s\n", concurrent ? "Concurrent" : "Serial",
+         (unsigned long)requests, (unsigned long)bus.frames, done ? (endUs - startUs) / 1000.0 : 0.0,
+         bus.load * 100.0f, (unsigned long)failures,
+         !done ? "TIMED OUT" : wrong == 0 ? "ok" : "WRONG");
+  return done && failures == 0 && wrong == 0;
+}
+
+int main(int argc, char** argv) {
+  uint32_t loopUs = argc > 1 ? atoi(argv[1]) : 1000;
+
+  printf("%u nodes, %u SDO downloads each, %lu us loop period, %u client transfer slots\n\n", CONFIG_SERVERS,
+         NUM_STEPS, (unsigned long)loopUs, SDO_MAX_CLIENT_TRANSFERS);
+  printf("Mode        Requests  Frames        ms  Load %%  Failed  Config\n");
+
+  bool ok = runConfig(false, loopUs);
+  double serialMs = (endUs - startUs) / 1000.0;
+  ok = runConfig(true, loopUs) && ok;
+  double concurrentMs = (endUs - startUs) / 1000.0;
+  if (ok) printf("\nConcurrent is %.1fx faster than serial\n", serialMs / concurrentMs);
+  return ok ? 0 : 1;
+}
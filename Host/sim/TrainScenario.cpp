@@ -0,0 +1,267 @@
+/**
+ * CAN MREX Train bus simulator scenario
+ *
+ * File:            TrainScenario.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * The CAN side of the sketches in Prototypes/ on one bus: same OD entries, PDO mappings, event and inhibit
+ * timers. Sensor reads are replaced by values that change at the rate the sketch samples them.
+ *
+ * Usage: train_sim [seconds] [loop_us] [sync_ms]
+ *
+ * With sync_ms the Controller produces SYNC at that period and the Controller -> Motor -> Brakes PDOs are
+ * synchronous (type 1), so those three sample and actuate in lock-step
+ */
+
+#include <stdlib.h>
+#include "TrainSim.h"
+
+// Node IDs as in the sketches, except Rotary_encoder (1 in its sketch, same as Motor) and Lights
+// (2, same as Brakes) which are moved so every node on the bus has its own ID
+#define MOTOR_ID      1
+#define BRAKES_ID     2
+#define CONTROLLER_ID 3
+#define ENCODER_ID    4
+#define LIGHTS_ID     5
+#define BATTERY_ID    7
+
+static const gpio_num_t TX_GPIO_NUM = GPIO_NUM_5;
+static const gpio_num_t RX_GPIO_NUM = GPIO_NUM_4;
+
+static uint16_t syncMs = 0;
+
+// Transmission type for the control loop PDOs, 255 (async) as in the sketches unless SYNC is on
+static uint8_t controlPdoType() {
+  return syncMs > 0 ? 1 : 255;
+}
+
+// Cheap deterministic stand-in for analogRead() noise
+static uint32_t noiseState = 12345;
+static uint16_t noise(uint16_t range) {
+  noiseState = noiseState * 1103515245u + 12345u;
+  return (noiseState >> 16) % range;
+}
+
+// --- Motor ---
+static uint16_t motorDesiredSpeed, motorRegenBrake;
+static CmWatched<uint8_t> motorServiceBrake;  // TPDO goes out as soon as it changes, not at the next event timer
+
+static void motorSetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+  registerODEntry(0x60FF, 0x00, 2, sizeof(motorDesiredSpeed), &motorDesiredSpeed);
+  registerODEntry(0x3012, 0x00, 2, sizeof(motorRegenBrake), &motorRegenBrake);
+  registerODEntry(0x3012, 0x01, 2, sizeof(motorServiceBrake), &motorServiceBrake);
+  configureTPDO(0, 0x180 + nodeID, controlPdoType(), 100, 100);
+  PdoMapEntry tpdoEntries[] = {{0x3012, 0x01, 8}};
+  mapTPDO(0, tpdoEntries, 1);
+  setTPDOSendMode(0, TPDO_SEND_ON_CHANGE); // motorServiceBrake is watched, no need to sample it
+  configureRPDO(0, 0x180 + CONTROLLER_ID, controlPdoType(), 0);
+  PdoMapEntry rpdoEntries[] = {{0x60FF, 0x00, 16}, {0x3012, 0x00, 16}};
+  mapRPDO(0, rpdoEntries, 2);
+  // Three missed Controller event timers and the motor stops with full regen braking
+  motorDesiredSpeed = 0;
+  motorRegenBrake = 1023;
+  setRPDOSafeDefaults(0);
+  setRPDOTimeout(0, 300);
+  setRPDOBuffered(0, true); // speed and regen brake always change together, even with handleCAN in another task
+  nodeOperatingMode = 0x01;
+}
+
+static void motorLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  takeRPDOSnapshot(0);
+  if (nodeOperatingMode == 0x01) motorServiceBrake = motorRegenBrake > 900;
+}
+
+// --- Brakes ---
+static uint8_t brakesServiceBrake;
+
+static void brakesSetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+  registerODEntry(0x3012, 0x01, 2, sizeof(brakesServiceBrake), &brakesServiceBrake);
+  configureRPDO(0, 0x180 + MOTOR_ID, controlPdoType(), 0);
+  PdoMapEntry rpdoEntries[] = {{0x3012, 0x01, 8}};
+  mapRPDO(0, rpdoEntries, 1);
+  nodeOperatingMode = 0x01;
+}
+
+static void brakesLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+}
+
+// --- Controller ---
+static uint16_t controllerDesiredSpeed, controllerRegenBrake;
+static uint8_t controllerDirectionMode = 1;
+
+// What the Controller monitors from the rest of the train, five RPDOs (host build has CM_MAX_RPDOS 8)
+static uint8_t ctrlServiceBrake;
+static uint16_t ctrlRPM;
+static uint8_t ctrlCurrentSign, ctrlAhSign, ctrlPowerSign, ctrlRecoveredSign;
+static uint32_t ctrlCurrent, ctrlAh, ctrlRecovered;
+static uint16_t ctrlVoltage, ctrlSoc, ctrlPower;
+
+CM_OD_TABLE(controllerMonitorOD,
+  CM_OD_ENTRY(0x2000, 0x00, 0, ctrlCurrentSign),
+  CM_OD_ENTRY(0x2000, 0x01, 0, ctrlCurrent),
+  CM_OD_ENTRY(0x2000, 0x02, 0, ctrlVoltage),
+  CM_OD_ENTRY(0x2000, 0x03, 0, ctrlAhSign),
+  CM_OD_ENTRY(0x2000, 0x04, 0, ctrlAh),
+  CM_OD_ENTRY(0x2000, 0x05, 0, ctrlSoc),
+  CM_OD_ENTRY(0x2000, 0x06, 0, ctrlPowerSign),
+  CM_OD_ENTRY(0x2000, 0x07, 0, ctrlPower),
+  CM_OD_ENTRY(0x2000, 0x08, 0, ctrlRecoveredSign),
+  CM_OD_ENTRY(0x2000, 0x09, 0, ctrlRecovered),
+  CM_OD_ENTRY(0x3012, 0x01, 0, ctrlServiceBrake),
+  CM_OD_ENTRY(0x606C, 0x00, 0, ctrlRPM));
+
+static void controllerSetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+  registerODEntry(0x60FF, 0x00, 2, sizeof(controllerDesiredSpeed), &controllerDesiredSpeed);
+  registerODEntry(0x3012, 0x00, 2, sizeof(controllerRegenBrake), &controllerRegenBrake);
+  registerODEntry(0x6060, 0x00, 2, sizeof(controllerDirectionMode), &controllerDirectionMode);
+  configureTPDO(0, 0x180 + nodeID, controlPdoType(), 100, 100);
+  PdoMapEntry tpdoEntries[] = {{0x60FF, 0x00, 16}, {0x3012, 0x00, 16}};
+  mapTPDO(0, tpdoEntries, 2);
+  setupSyncProducer(syncMs);
+
+  registerODTable(controllerMonitorOD);
+  configureRPDO(0, 0x180 + MOTOR_ID, 255, 0);
+  configureRPDO(1, 0x180 + ENCODER_ID, 255, 0);
+  configureRPDO(2, 0x180 + BATTERY_ID, 255, 0);
+  configureRPDO(3, 0x280 + BATTERY_ID, 255, 0);
+  configureRPDO(4, 0x380 + BATTERY_ID, 255, 0);
+  PdoMapEntry motorEntries[] = {{0x3012, 0x01, 8}};
+  PdoMapEntry encoderEntries[] = {{0x606C, 0x00, 16}};
+  PdoMapEntry batteryEntries1[] = {{0x2000, 0x00, 8}, {0x2000, 0x01, 32}, {0x2000, 0x02, 16}};
+  PdoMapEntry batteryEntries2[] = {{0x2000, 0x03, 8}, {0x2000, 0x04, 32}, {0x2000, 0x05, 16}};
+  PdoMapEntry batteryEntries3[] = {{0x2000, 0x06, 8}, {0x2000, 0x07, 16}, {0x2000, 0x08, 8}, {0x2000, 0x09, 32}};
+  mapRPDO(0, motorEntries, 1);
+  mapRPDO(1, encoderEntries, 1);
+  mapRPDO(2, batteryEntries1, 3);
+  mapRPDO(3, batteryEntries2, 3);
+  mapRPDO(4, batteryEntries3, 4);
+
+  // The sketch starts the train from the mode switch, here every node is started straight away
+  nodeOperatingMode = 0x01;
+  const uint8_t train[] = {MOTOR_ID, BRAKES_ID, ENCODER_ID, LIGHTS_ID, BATTERY_ID};
+  for (uint8_t id : train) sendNMT(0x01, id);
+}
+
+static void controllerLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (nodeOperatingMode != 0x01) return;
+  controllerRegenBrake = 500 + noise(8);  // analogRead() of the brake and speed pots
+  controllerDesiredSpeed = 2000 + noise(8);
+}
+
+// --- Rotary encoder ---
+static uint16_t encoderRPM;
+static uint32_t encoderLastUpdate;
+
+static void encoderSetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+  registerODEntry(0x606C, 0x00, 2, sizeof(encoderRPM), &encoderRPM);
+  configureTPDO(0, 0x180 + nodeID, 255, 10, 100);
+  PdoMapEntry tpdoEntries[] = {{0x606C, 0x00, 16}};
+  mapTPDO(0, tpdoEntries, 1);
+  nodeOperatingMode = 0x01;
+}
+
+static void encoderLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (nodeOperatingMode != 0x01) return;
+  if (micros() - encoderLastUpdate >= 200000) {  // RPM worked out from the pulse counter every 200 ms
+    encoderRPM = 1200 + noise(50);
+    encoderLastUpdate = micros();
+  }
+}
+
+// --- Lights ---
+// The sketch calls executeSDORead() every 200 ms. The blocking call can't wait for the simulated bus,
+// so the same request goes through the async client
+static uint32_t lightsNextPoll;
+static SdoHandle lightsRequest = SDO_INVALID_HANDLE;
+
+static void lightsSetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+}
+
+static void lightsLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (nodeOperatingMode != 0x01) return;
+  if (millis() >= lightsNextPoll && sdoPoll(lightsRequest) != SDO_PENDING) {
+    lightsRequest = sdoReadAsync(nodeID, CONTROLLER_ID, 0x6060, 0x00);
+    lightsNextPoll = millis() + 200;
+  }
+}
+
+// --- Battery ---
+// Declared as a compile-time table, so the duplicate 0x2000/0x08 and the mapping of a missing 0x2000/0x09
+// that the sketch used to have can't come back
+static uint8_t batteryCurrentSign, batteryAhSign, batteryPowerSign, batteryRecoveredSign;
+static uint32_t batteryCurrent, batteryAh, batteryRecovered;
+static uint16_t batteryVoltage, batterySoc, batteryPower;
+static uint32_t batteryLastUpdate;
+
+CM_OD_TABLE(batteryOD,
+  CM_OD_ENTRY(0x2000, 0x00, 0, batteryCurrentSign),
+  CM_OD_ENTRY(0x2000, 0x01, 0, batteryCurrent),
+  CM_OD_ENTRY(0x2000, 0x02, 0, batteryVoltage),
+  CM_OD_ENTRY(0x2000, 0x03, 0, batteryAhSign),
+  CM_OD_ENTRY(0x2000, 0x04, 0, batteryAh),
+  CM_OD_ENTRY(0x2000, 0x05, 0, batterySoc),
+  CM_OD_ENTRY(0x2000, 0x06, 0, batteryPowerSign),
+  CM_OD_ENTRY(0x2000, 0x07, 0, batteryPower),
+  CM_OD_ENTRY(0x2000, 0x08, 0, batteryRecoveredSign),
+  CM_OD_ENTRY(0x2000, 0x09, 0, batteryRecovered));
+
+constexpr PdoMapEntry batteryTpdo1[] = {{0x2000, 0x00, 8}, {0x2000, 0x01, 32}, {0x2000, 0x02, 16}};
+constexpr PdoMapEntry batteryTpdo2[] = {{0x2000, 0x03, 8}, {0x2000, 0x04, 32}, {0x2000, 0x05, 16}};
+constexpr PdoMapEntry batteryTpdo3[] = {{0x2000, 0x06, 8}, {0x2000, 0x07, 16}, {0x2000, 0x08, 8}, {0x2000, 0x09, 32}};
+CM_CHECK_TPDO_MAPPING(batteryOD, batteryTpdo1);
+CM_CHECK_TPDO_MAPPING(batteryOD, batteryTpdo2);
+CM_CHECK_TPDO_MAPPING(batteryOD, batteryTpdo3);
+
+static void batterySetup(uint8_t nodeID) {
+  initCANMREX(TX_GPIO_NUM, RX_GPIO_NUM, nodeID);
+  registerODTable(batteryOD);
+  configureTPDO(0, 0x180 + nodeID, 255, 100, 1000);
+  configureTPDO(1, 0x280 + nodeID, 255, 100, 1000);
+  configureTPDO(2, 0x380 + nodeID, 255, 100, 1000);
+  mapTPDO(0, batteryTpdo1, 3);
+  mapTPDO(1, batteryTpdo2, 3);
+  mapTPDO(2, batteryTpdo3, 4);
+}
+
+static void batteryLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (nodeOperatingMode != 0x01) return;
+  if (millis() - batteryLastUpdate >= 500) {  // the shunt sends a new block every second, read every 500 ms
+    batteryLastUpdate = millis();
+    batteryCurrent = 15000 + noise(100);
+    batteryVoltage = 4800 + noise(10);
+    batteryPower = batteryCurrent / 100;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = argc > 1 ? atoi(argv[1]) : 10;
+  uint32_t loopUs = argc > 2 ? atoi(argv[2]) : 1000;
+  syncMs = argc > 3 ? atoi(argv[3]) : 0;
+
+  simReset();
+  simAddNode({"Motor", MOTOR_ID, motorSetup, motorLoop, loopUs, 0});
+  simAddNode({"Brakes", BRAKES_ID, brakesSetup, brakesLoop, loopUs, 0});
+  simAddNode({"Rotary_encoder", ENCODER_ID, encoderSetup, encoderLoop, loopUs, 0});
+  simAddNode({"Lights", LIGHTS_ID, lightsSetup, lightsLoop, loopUs, 0});
+  simAddNode({"Battery", BATTERY_ID, batterySetup, batteryLoop, loopUs, 0});
+  simAddNode({"Controller", CONTROLLER_ID, controllerSetup, controllerLoop, loopUs, 1000}); // after the others are listening
+
+  simRun(seconds * 1000);
+  simPrintReport(stdout);
+  return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * CAN MREX Train bus simulator
+ *
+ * File:            TrainSim.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "TrainSim.h"
+#include "HostBus.h"
+
+typedef struct {
+  SimNodeConfig config;
+  CanMrexNode*  ctx;
+  uint8_t       port;
+  bool          started;
+  uint64_t      nextRunNs;
+} SimNode;
+
+static SimNode nodes[SIM_MAX_NODES];
+static uint8_t nodeCount = 0;
+static uint32_t bitRate = CAN_BITRATE_DEFAULT;
+static uint64_t nowNs = 0;
+
+static SimCobStats cobStats[2048];
+
+// Frame currently on the bus
+static bool busBusy = false;
+static bool busDelivered = false;
+static twai_message_t busMsg;
+static uint8_t busPort = 0;
+static uint64_t busQueuedUs = 0;
+static uint16_t busBits = 0;
+static uint64_t busStartNs = 0;
+static uint64_t busEofNs = 0;    // last bit of EOF, receivers take the frame here
+static uint64_t busFreeNs = 0;   // end of intermission, the next SOF can start
+
+// Totals and the load window
+static uint64_t busyNs = 0;
+static uint32_t frameCount = 0;
+static uint64_t windowStartNs = 0;
+static uint64_t windowBusyNs = 0;
+static float peakLoad = 0.0f;
+
+static uint64_t bitsToNs(uint32_t bits) {
+  return (uint64_t)bits * 1000000000ull / bitRate;
+}
+
+static void selectSimNode(SimNode& n) {
+  hostBusSelectPort(n.port);
+  cmSelectNode(n.ctx);
+}
+
+// Adds [start, end) to the bus busy time, closing every load window the interval runs past
+static void addBusy(uint64_t start, uint64_t end) {
+  const uint64_t windowNs = (uint64_t)SIM_LOAD_WINDOW_US * 1000;
+  busyNs += end - start;
+  while (end > windowStartNs + windowNs) {
+    uint64_t windowEnd = windowStartNs + windowNs;
+    if (start < windowEnd) {
+      windowBusyNs += windowEnd - start;
+      start = windowEnd;
+    }
+    float load = (float)windowBusyNs / windowNs;
+    if (load > peakLoad) peakLoad = load;
+    windowStartNs = windowEnd;
+    windowBusyNs = 0;
+  }
+  if (end > start) windowBusyNs += end - start;
+}
+
+// Arbitration: the lowest COB-ID queued on any port when the bus goes idle wins
+static void startFrame() {
+  if (!hostBusBeginTransfer(&busMsg, &busPort, &busQueuedUs)) return;
+  busBits = canFrameBits(busMsg);
+  busStartNs = nowNs;
+  busEofNs = nowNs + bitsToNs(busBits - CAN_IFS_BITS);
+  busFreeNs = nowNs + bitsToNs(busBits);
+  busBusy = true;
+  busDelivered = false;
+
+  uint64_t startUs = nowNs / 1000;
+  SimCobStats& s = cobStats[busMsg.identifier & 0x7FF];
+  uint32_t queued = (uint32_t)(startUs - busQueuedUs);
+  if (queued > s.worstQueueUs) s.worstQueueUs = queued;
+  if (s.frames > 0) {
+    uint32_t gap = (uint32_t)(startUs - s.lastStartUs);
+    if (s.minIntervalUs == 0 || gap < s.minIntervalUs) s.minIntervalUs = gap;
+  }
+  s.lastStartUs = startUs;
+}
+
+static void finishFrame() {
+  hostBusFinishTransfer(busMsg, busPort);
+  busDelivered = true;
+  frameCount++;
+
+  SimCobStats& s = cobStats[busMsg.identifier & 0x7FF];
+  uint32_t latency = (uint32_t)(busEofNs / 1000 - busQueuedUs);
+  s.frames++;
+  s.totalBits += busBits;
+  if (s.minBits == 0 || busBits < s.minBits) s.minBits = busBits;
+  if (busBits > s.maxBits) s.maxBits = busBits;
+  s.totalLatencyUs += latency;
+  if (latency > s.worstLatencyUs) s.worstLatencyUs = latency;
+  for (uint8_t i = 0; i < nodeCount; i++) {
+    if (nodes[i].port == busPort) s.sender = i;
+  }
+}
+
+void simReset(uint32_t bitrate) {
+  for (uint8_t i = 0; i < nodeCount; i++) delete nodes[i].ctx;
+  nodeCount = 0;
+  bitRate = bitrate;
+  nowNs = 0;
+  memset(cobStats, 0, sizeof(cobStats));
+  busBusy = false;
+  busyNs = 0;
+  frameCount = 0;
+  windowStartNs = 0;
+  windowBusyNs = 0;
+  peakLoad = 0.0f;
+  hostBusReset();
+  hostClockSetManual(true);
+  hostClockSetMicros(0);
+  cmSelectNode(nullptr);
+}
+
+int8_t simAddNode(const SimNodeConfig& config) {
+  if (nodeCount >= SIM_MAX_NODES) return -1;
+  uint8_t port = hostBusAddPort();
+  if (port == HOST_BUS_NO_PORT) return -1;
+  SimNode& n = nodes[nodeCount];
+  n.config = config;
+  if (n.config.loopPeriodUs == 0) n.config.loopPeriodUs = 1;
+  n.ctx = new CanMrexNode();
+  n.port = port;
+  n.started = false;
+  n.nextRunNs = (uint64_t)config.startUs * 1000;
+  return nodeCount++;
+}
+
+void simRun(uint32_t durationMs) {
+  uint64_t endNs = nowNs + (uint64_t)durationMs * 1000000ull;
+  for (;;) {
+    hostClockSetMicros(nowNs / 1000);
+
+    // Bus first, so a frame that completes now is already in the receivers' queues when their loop runs
+    if (busBusy && !busDelivered && nowNs >= busEofNs) finishFrame();
+    if (busBusy && nowNs >= busFreeNs) {
+      addBusy(busStartNs, busFreeNs);
+      busBusy = false;
+    }
+
+    for (uint8_t i = 0; i < nodeCount; i++) {
+      SimNode& n = nodes[i];
+      if (n.nextRunNs > nowNs) continue;
+      selectSimNode(n);
+      if (!n.started) {
+        n.started = true;
+        if (n.config.setup != nullptr) n.config.setup(n.config.nodeID);
+      } else if (n.config.loop != nullptr) {
+        n.config.loop(n.config.nodeID);
+      }
+      hostClockSetMicros(nowNs / 1000); // setup() may have called delay()
+      n.nextRunNs = nowNs + (uint64_t)n.config.loopPeriodUs * 1000;
+    }
+
+    if (!busBusy) startFrame();
+
+    uint64_t next = UINT64_MAX;
+    for (uint8_t i = 0; i < nodeCount; i++) {
+      if (nodes[i].nextRunNs < next) next = nodes[i].nextRunNs;
+    }
+    if (busBusy) {
+      uint64_t busNext = busDelivered ? busFreeNs : busEofNs;
+      if (busNext < next) next = busNext;
+    }
+    if (next > endNs) break;
+    nowNs = next;
+  }
+  nowNs = endNs;
+  hostClockSetMicros(nowNs / 1000);
+}
+
+CanMrexNode* simNode(uint8_t index) {
+  return index < nodeCount ? nodes[index].ctx : nullptr;
+}
+
+const SimNodeConfig* simNodeConfig(uint8_t index) {
+  return index < nodeCount ? &nodes[index].config : nullptr;
+}
+
+uint8_t simNodeCount() {
+  return nodeCount;
+}
+
+const SimCobStats* simCobStats(uint16_t cobID) {
+  if (cobID >= 2048 || cobStats[cobID].frames == 0) return nullptr;
+  return &cobStats[cobID];
+}
+
+SimBusStats simBusStats() {
+  SimBusStats s;
+  s.elapsedUs = nowNs / 1000;
+  s.busyUs = busyNs / 1000;
+  s.frames = frameCount;
+  s.load = nowNs > 0 ? (float)busyNs / nowNs : 0.0f;
+  s.peakLoad = peakLoad;
+  return s;
+}
+
+void simPrintReport(FILE* out) {
+  SimBusStats bus = simBusStats();
+  fprintf(out, "Bus: %lu kbit/s, %.3f s simulated, %lu frames, load %.2f %%, peak %.2f %% (%u ms windows)\n\n",
+          (unsigned long)(bitRate / 1000), bus.elapsedUs / 1e6, (unsigned long)bus.frames, bus.load * 100.0f,
+          bus.peakLoad * 100.0f, SIM_LOAD_WINDOW_US / 1000);
+
+  fprintf(out, "COB-ID  Sender          Frames   Bits     Min gap ms  Avg lat us  Worst queue us  Worst lat us\n");
+  for (uint16_t id = 0; id < 2048; id++) {
+    const SimCobStats* s = simCobStats(id);
+    if (s == nullptr) continue;
+    char bits[16];
+    snprintf(bits, sizeof(bits), "%u-%u", s->minBits, s->maxBits);
+    fprintf(out, "0x%03X   %-14s  %7lu  %-7s  %10.1f  %10lu  %14lu  %12lu\n", id, nodes[s->sender].config.name,
+            (unsigned long)s->frames, bits, s->minIntervalUs / 1000.0, (unsigned long)(s->totalLatencyUs / s->frames),
+            (unsigned long)s->worstQueueUs, (unsigned long)s->worstLatencyUs);
+  }
+
+  // Time spent in the stack's own transmit queue before the driver took the frame
+  static const char* classNames[CAN_TX_CLASSES] = {"EMCY", "NMT", "PDO", "SDO", "HB"};
+  fprintf(out, "\nNode            ID   OD used/capacity (table)  TX queue worst wait us (dropped)\n");
+  for (uint8_t i = 0; i < nodeCount; i++) {
+    selectSimNode(nodes[i]);
+    CanTxStats tx = getCANTxStats();
+    OdStats od = getODStats();
+    char odUse[24];
+    snprintf(odUse, sizeof(odUse), "%u/%u (%u)", od.used, od.capacity, od.tableEntries);
+    fprintf(out, "%-14s  %3u  %-24s", nodes[i].config.name, nodes[i].config.nodeID, odUse);
+    for (uint8_t c = 0; c < CAN_TX_CLASSES; c++) {
+      fprintf(out, "  %s %lu (%lu)", classNames[c], (unsigned long)tx.maxWaitUs[c], (unsigned long)tx.dropped[c]);
+    }
+    fprintf(out, "\n");
+  }
+}
@@ -0,0 +1,76 @@
+/**
+ * CAN MREX Train bus simulator
+ *
+ * File:            TrainSim.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Discrete-event simulation of a whole train on one bus. Every node runs the real stack from main/ in its own
+ * CanMrexNode on its own virtual bus port. Frames take their exact stuffed length in bit times on the bus and
+ * the lowest COB-ID waiting when the bus goes idle wins arbitration.
+ */
+
+#ifndef TRAIN_SIM_H
+#define TRAIN_SIM_H
+
+#include <stdio.h>
+#include "CM.h"
+#include "CanBitTiming.h"
+
+#ifndef SIM_MAX_NODES
+#define SIM_MAX_NODES      32       // one port each on the virtual bus (HOST_BUS_MAX_PORTS)
+#endif
+#define SIM_LOAD_WINDOW_US 100000   // window used for the peak bus load
+
+// setup() runs once at the node's power-on time, loop() once per loop period after that.
+// Both run with the node and its bus port selected, so they can call the CAN MREX API as a sketch would
+typedef void (*SimNodeSetup)(uint8_t nodeID);
+typedef void (*SimNodeLoop)(uint8_t nodeID);
+
+typedef struct {
+  const char*  name;
+  uint8_t      nodeID;
+  SimNodeSetup setup;
+  SimNodeLoop  loop;
+  uint32_t     loopPeriodUs;  // time one pass of the sketch's loop() takes
+  uint32_t     startUs;       // power-on time
+} SimNodeConfig;
+
+// Per COB-ID results. Delays are counted from when the frame was handed to twai_transmit(),
+// time spent earlier in the node's transmit queue is in CanTxStats.maxWaitUs
+typedef struct {
+  uint32_t frames;
+  uint8_t  sender;            // node index of the last sender
+  uint16_t minBits;
+  uint16_t maxBits;
+  uint64_t totalBits;
+  uint32_t worstQueueUs;      // waiting for the bus to go idle and losing arbitration
+  uint32_t worstLatencyUs;    // queued until the last bit of EOF
+  uint64_t totalLatencyUs;
+  uint32_t minIntervalUs;     // shortest time between two frames with this COB-ID (0 until there are two)
+  uint64_t lastStartUs;
+} SimCobStats;
+
+typedef struct {
+  uint64_t elapsedUs;
+  uint64_t busyUs;            // includes intermission
+  uint32_t frames;
+  float    load;              // busyUs / elapsedUs
+  float    peakLoad;          // highest load over any SIM_LOAD_WINDOW_US window
+} SimBusStats;
+
+void simReset(uint32_t bitrate = CAN_BITRATE_DEFAULT);
+int8_t simAddNode(const SimNodeConfig& config);  // returns the node index, -1 when full
+void simRun(uint32_t durationMs);                // continues from where the last call stopped
+CanMrexNode* simNode(uint8_t index);
+const SimNodeConfig* simNodeConfig(uint8_t index);
+uint8_t simNodeCount();
+
+const SimCobStats* simCobStats(uint16_t cobID);  // nullptr if the COB-ID was never sent
+SimBusStats simBusStats();
+void simPrintReport(FILE* out);
+
+#endif
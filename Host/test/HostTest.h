@@ -0,0 +1,50 @@
+/**
+ * CAN MREX host test checks
+ *
+ * File:            HostTest.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Just enough for the CTest executables in Host/test: CM_CHECK reports a failed condition with its line and
+ * carries on, so one run lists every failure. main() returns hostTestResult(), which CTest reads as pass/fail.
+ */
+
+#ifndef CM_HOST_TEST_H
+#define CM_HOST_TEST_H
+
+#include <stdio.h>
+
+static unsigned hostTestChecks = 0;
+static unsigned hostTestFailures = 0;
+
+#define CM_CHECK(cond) hostTestCheck((cond), #cond, __FILE__, __LINE__)
+#define CM_CHECK_EQ(a, b) hostTestCheckEq((unsigned long long)(a), (unsigned long long)(b), #a " == " #b, __FILE__, __LINE__)
+
+static inline bool hostTestCheck(bool ok, const char* what, const char* file, int line) {
+  hostTestChecks++;
+  if (!ok) {
+    hostTestFailures++;
+    printf("%s:%d: check failed: %s\n", file, line, what);
+  }
+  return ok;
+}
+
+static inline bool hostTestCheckEq(unsigned long long a, unsigned long long b, const char* what, const char* file,
+                                   int line) {
+  hostTestChecks++;
+  if (a != b) {
+    hostTestFailures++;
+    printf("%s:%d: check failed: %s (0x%llx != 0x%llx)\n", file, line, what, a, b);
+  }
+  return a == b;
+}
+
+static inline int hostTestResult(const char* name) {
+  printf("%s: %u checks, %u failed\n", name, hostTestChecks, hostTestFailures);
+  return hostTestFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * CAN MREX PDO timing and unpack tests
+ *
+ * File:            PdoTest.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * TPDO event timer and inhibit time spacing measured on the simulated bus with a bus observer, the RPDO
+ * those frames feed on a second node, unpackRPDO() of a bit-packed mapping against a hand-made frame, and PDO
+ * object writes that must be refused. Sampled TPDOs on plain variables, with and without an event timer, must
+ * send each change within a loop once the event timer allows.
+ */
+
+#include <string.h>
+#include "TrainSim.h"
+#include "HostBus.h"
+#include "HostTest.h"
+
+#define TEST_PRODUCER_ID  1
+#define TEST_CONSUMER_ID  2
+#define TEST_EVENT_COB    0x181
+#define TEST_INHIBIT_COB  0x281
+#define TEST_EVENT_MS     100
+#define TEST_INHIBIT_MS   20
+#define TEST_RUN_MS       1000
+#define TEST_MAX_FRAMES   256
+#define TEST_SLACK_US     1000   // loop period and frame time on top of the configured spacing
+
+static uint32_t eventValue = 0xDEADBEEF;
+static uint16_t changingValue;
+static uint32_t receivedEvent;
+static uint16_t receivedChanging;
+
+static uint64_t eventUs[TEST_MAX_FRAMES];
+static uint16_t eventFrames;
+static uint64_t inhibitUs[TEST_MAX_FRAMES];
+static uint16_t inhibitFrames;
+static uint16_t lastSentChanging;
+
+static void observe(const twai_message_t& msg, uint8_t fromPort, void* arg) {
+  if (msg.identifier == TEST_EVENT_COB && eventFrames < TEST_MAX_FRAMES) eventUs[eventFrames++] = hostClockMicros();
+  if (msg.identifier == TEST_INHIBIT_COB && inhibitFrames < TEST_MAX_FRAMES) {
+    inhibitUs[inhibitFrames++] = hostClockMicros();
+    memcpy(&lastSentChanging, msg.data, 2);
+  }
+}
+
+// TPDO1 sent every event timer period although its value never changes, TPDO2 on every change but held back by
+// its inhibit time
+static void producerSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  registerODEntry(0x2000, 1, 2, 4, &eventValue);
+  registerODEntry(0x2000, 2, 2, 2, &changingValue);
+  PdoMapEntry eventMap[] = {{0x2000, 1, 32}};
+  PdoMapEntry changingMap[] = {{0x2000, 2, 16}};
+  configureTPDO(0, TEST_EVENT_COB, 255, 0, TEST_EVENT_MS);
+  mapTPDO(0, eventMap, 1);
+  setTPDOSendMode(0, TPDO_SEND_ON_CHANGE_PERIODIC);
+  configureTPDO(1, TEST_INHIBIT_COB, 254, TEST_INHIBIT_MS, 0);
+  mapTPDO(1, changingMap, 1);
+  setTPDOSendMode(1, TPDO_SEND_ON_CHANGE);
+  nodeOperatingMode = 0x01;
+}
+
+static void producerLoop(uint8_t nodeID) {
+  uint16_t next = changingValue + 1;
+  writeODEntry(0x2000, 2, &next, 2);
+  handleCAN(nodeID);
+}
+
+static void consumerSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  registerODEntry(0x2000, 1, 2, 4, &receivedEvent);
+  registerODEntry(0x2000, 2, 2, 2, &receivedChanging);
+  PdoMapEntry eventMap[] = {{0x2000, 1, 32}};
+  PdoMapEntry changingMap[] = {{0x2000, 2, 16}};
+  configureRPDO(0, TEST_EVENT_COB, 255, 0);
+  mapRPDO(0, eventMap, 1);
+  configureRPDO(1, TEST_INHIBIT_COB, 255, 0);
+  mapRPDO(1, changingMap, 1);
+  nodeOperatingMode = 0x01;
+}
+
+static void consumerLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+}
+
+static void testTimingAndDelivery() {
+  simReset();
+  hostBusSetObserver(observe, nullptr);
+  simAddNode({"Producer", TEST_PRODUCER_ID, producerSetup, producerLoop, 250, 0});
+  simAddNode({"Consumer", TEST_CONSUMER_ID, consumerSetup, consumerLoop, 250, 0});
+  simRun(TEST_RUN_MS);
+  hostBusSetObserver(nullptr, nullptr);
+
+  // Event timer: one frame per period, never early and never more than a loop late
+  CM_CHECK(eventFrames >= TEST_RUN_MS / TEST_EVENT_MS - 1);
+  CM_CHECK(eventFrames <= TEST_RUN_MS / TEST_EVENT_MS + 1);
+  for (uint16_t i = 1; i < eventFrames; i++) {
+    uint64_t gap = eventUs[i] - eventUs[i - 1];
+    CM_CHECK(gap + TEST_SLACK_US >= TEST_EVENT_MS * 1000ull && gap <= TEST_EVENT_MS * 1000ull + TEST_SLACK_US);
+  }
+
+  // Inhibit time: the value changes every loop, so frames go out as soon as the inhibit time allows
+  CM_CHECK(inhibitFrames >= TEST_RUN_MS / TEST_INHIBIT_MS - 2);
+  for (uint16_t i = 1; i < inhibitFrames; i++) {
+    uint64_t gap = inhibitUs[i] - inhibitUs[i - 1];
+    CM_CHECK(gap >= TEST_INHIBIT_MS * 1000ull - TEST_SLACK_US);
+    CM_CHECK(gap <= TEST_INHIBIT_MS * 1000ull + TEST_SLACK_US);
+  }
+
+  // RPDOs on the consumer hold what was last sent
+  CM_CHECK_EQ(receivedEvent, 0xDEADBEEF);
+  CM_CHECK_EQ(receivedChanging, lastSentChanging);
+}
+
+// Sampled TPDOs on plain variables, nothing marks them dirty: one with no event timer and one with
+// TEST_SAMPLED_MS as the shortest gap between frames
+#define TEST_SAMPLED_FAST_COB  0x182
+#define TEST_SAMPLED_SLOW_COB  0x282
+#define TEST_SAMPLED_MS        100
+#define TEST_SAMPLED_RUN_MS    500
+
+typedef struct {
+  uint32_t ms;
+  bool     slow;    // which variable is changed
+} SampledChange;
+
+static const SampledChange sampledChanges[] = {{10, true}, {50, false}, {120, false}, {300, false}, {410, true}};
+static const uint8_t NUM_SAMPLED_CHANGES = sizeof(sampledChanges) / sizeof(sampledChanges[0]);
+
+static uint16_t sampledFast;
+static uint16_t sampledSlow;
+static uint8_t sampledNext;
+static uint64_t fastUs[TEST_MAX_FRAMES];
+static uint16_t fastFrames;
+static uint64_t slowUs[TEST_MAX_FRAMES];
+static uint16_t slowFrames;
+
+static void observeSampled(const twai_message_t& msg, uint8_t fromPort, void* arg) {
+  if (msg.identifier == TEST_SAMPLED_FAST_COB && fastFrames < TEST_MAX_FRAMES) fastUs[fastFrames++] = hostClockMicros();
+  if (msg.identifier == TEST_SAMPLED_SLOW_COB && slowFrames < TEST_MAX_FRAMES) slowUs[slowFrames++] = hostClockMicros();
+}
+
+static void sampledSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  registerODEntry(0x2000, 1, 2, 2, &sampledFast);
+  registerODEntry(0x2000, 2, 2, 2, &sampledSlow);
+  PdoMapEntry fastMap[] = {{0x2000, 1, 16}};
+  PdoMapEntry slowMap[] = {{0x2000, 2, 16}};
+  configureTPDO(0, TEST_SAMPLED_FAST_COB, 255, 0, 0);
+  mapTPDO(0, fastMap, 1);
+  configureTPDO(1, TEST_SAMPLED_SLOW_COB, 255, 0, TEST_SAMPLED_MS);
+  mapTPDO(1, slowMap, 1);
+  nodeOperatingMode = 0x01;
+}
+
+// Writes the variables directly, as a sketch would, at the scripted times
+static void sampledLoop(uint8_t nodeID) {
+  if (sampledNext < NUM_SAMPLED_CHANGES && millis() >= sampledChanges[sampledNext].ms) {
+    if (sampledChanges[sampledNext].slow) sampledSlow++;
+    else sampledFast++;
+    sampledNext++;
+  }
+  handleCAN(nodeID);
+}
+
+// A sampled TPDO is checked every loop once its event timer has passed since the last frame, so a change goes out
+// within a loop, or when the event timer runs out if it came sooner. With an event timer of 0 it is checked always
+static void testSampledTPDOs() {
+  simReset();
+  hostBusSetObserver(observeSampled, nullptr);
+  simAddNode({"Sampled", TEST_PRODUCER_ID, sampledSetup, sampledLoop, 1000, 0});
+  simRun(TEST_SAMPLED_RUN_MS);
+  hostBusSetObserver(nullptr, nullptr);
+
+  // Event timer 0: the first frame, then one per change within two loops
+  CM_CHECK_EQ(fastFrames, 4);
+  const uint32_t fastChanges[] = {50, 120, 300};
+  for (uint8_t i = 1; i < fastFrames && i < 4; i++) {
+    CM_CHECK(fastUs[i] >= fastChanges[i - 1] * 1000ull && fastUs[i] <= fastChanges[i - 1] * 1000ull + 2000);
+  }
+
+  // Event timer 100 ms: the change at 10 ms waits for the timer, the one at 410 ms goes straight out
+  CM_CHECK_EQ(slowFrames, 3);
+  if (slowFrames == 3) {
+    CM_CHECK(slowUs[1] + TEST_SLACK_US >= slowUs[0] + TEST_SAMPLED_MS * 1000ull);
+    CM_CHECK(slowUs[1] <= slowUs[0] + TEST_SAMPLED_MS * 1000ull + 2000);
+    CM_CHECK(slowUs[2] >= 410000ull && slowUs[2] <= 412000ull);
+  }
+}
+
+static CanMrexNode loneNode;  // node 3, set up by testBitPackedUnpack()
+
+// 3 bits, 13 bits, a byte and a signed 32 bit value packed LSB first: bits 0-2, 3-15, 16-23 and 24-55
+static void testBitPackedUnpack() {
+  cmSelectNode(&loneNode);
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, 3);
+  uint8_t small = 0;
+  uint16_t mid = 0;
+  uint8_t byte = 0;
+  int32_t wide = 0;
+  registerODEntry(0x2100, 1, 2, 1, &small);
+  registerODEntry(0x2100, 2, 2, 2, &mid);
+  registerODEntry(0x2100, 3, 2, 1, &byte);
+  registerODEntry(0x2100, 4, 2, 4, &wide);
+  PdoMapEntry map[] = {{0x2100, 1, 3}, {0x2100, 2, 13}, {0x2100, 3, 8}, {0x2100, 4, 32}};
+  configureRPDO(0, 0x203, 255, 0);
+  CM_CHECK(mapRPDO(0, map, 4));
+  nodeOperatingMode = 0x01;
+
+  // small = 5, mid = 0x1ABC, byte = 0x7E, wide = -2
+  uint64_t word = 5ull | (0x1ABCull << 3) | (0x7Eull << 16) | ((uint64_t)0xFFFFFFFEu << 24);
+  uint8_t frame[7];
+  memcpy(frame, &word, 7);
+  CM_CHECK(unpackRPDO(3, 0, frame, 7));
+  CM_CHECK_EQ(small, 5);
+  CM_CHECK_EQ(mid, 0x1ABC);
+  CM_CHECK_EQ(byte, 0x7E);
+  CM_CHECK_EQ(wide, -2);
+
+  // A frame shorter than the mapping is rejected and leaves the variables alone
+  uint8_t shortFrame[6] = {0};
+  CM_CHECK(!unpackRPDO(3, 0, shortFrame, 6));
+  CM_CHECK_EQ(small, 5);
+  cmSelectNode(nullptr);
+}
+
+// Writes to the PDO objects that would take over another consumer's COB-ID or stage a bad entry are refused
+static void testPdoObjectWrites() {
+  cmSelectNode(&loneNode);
+  uint32_t abortCode = 0;
+  const uint32_t taken[] = {0x000, 0x080, 0x085, 0x603, 0x701, 0x203};  // NMT, SYNC, EMCY, own SDO, heartbeat, RPDO 1
+  for (uint32_t cob : taken) {
+    abortCode = 0;
+    CM_CHECK(!writePDOObject(0x1401, 1, cob, &abortCode));
+    CM_CHECK_EQ(abortCode, SDO_ABORT_VALUE);
+  }
+  CM_CHECK(!configureRPDO(1, 0x000, 255, 0));
+  CM_CHECK_EQ(getCANDispatchKind(0x000), CAN_DISPATCH_NMT);
+  CM_CHECK(writePDOObject(0x1400, 1, 0x203));  // an RPDO keeps its own COB-ID
+  CM_CHECK(writePDOObject(0x1401, 1, 0x303));
+  CM_CHECK_EQ(getCANDispatchKind(0x303), CAN_DISPATCH_RPDO);
+  CM_CHECK(writePDOObject(0x1401, 1, 0x80000303u));
+  CM_CHECK_EQ(getCANDispatchKind(0x303), CAN_DISPATCH_NONE);
+
+  // A rejected entry for another mapping object leaves the staged one alone
+  uint32_t value = 0;
+  uint8_t size = 0;
+  CM_CHECK(writePDOObject(0x1600, 1, 0x21000108u));
+  abortCode = 0;
+  CM_CHECK(!writePDOObject(0x1601, 1, 0x21000100u, &abortCode));
+  CM_CHECK_EQ(abortCode, SDO_ABORT_VALUE);
+  CM_CHECK(readPDOObject(0x1600, 1, &value, &size));
+  CM_CHECK_EQ(value, 0x21000108u);
+  CM_CHECK(writePDOObject(0x1600, 0, 1));
+  cmSelectNode(nullptr);
+}
+
+int main() {
+  testBitPackedUnpack();  // first, while the bus still has the port a lone initCANMREX() installs on
+  testPdoObjectWrites();
+  testTimingAndDelivery();
+  testSampledTPDOs();
+  return hostTestResult("pdo_test");
+}
@@ -0,0 +1,150 @@
+/**
+ * CAN MREX receive ring tests
+ *
+ * File:            RxRingTest.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * CM_RxRing.h on its own: an empty ring, a full one counting drops, the buffer index and the free running
+ * 16 bit counters wrapping, and a producer and consumer thread passing frames through it in order.
+ */
+
+#include <string.h>
+#include <thread>
+#include "CM_RxRing.h"
+#include "HostTest.h"
+
+#define TEST_THREAD_FRAMES 200000
+
+// Frames carry a sequence number in identifier and data so order and content can both be checked
+static twai_message_t frame(uint32_t seq) {
+  twai_message_t m{};
+  m.identifier = seq & 0x7FF;
+  m.data_length_code = 4;
+  memcpy(m.data, &seq, 4);
+  return m;
+}
+
+static uint32_t frameSeq(const twai_message_t& m) {
+  uint32_t seq;
+  memcpy(&seq, m.data, 4);
+  return seq;
+}
+
+static void testEmpty(CanRxRing& r) {
+  rxRingReset(r);
+  twai_message_t m = frame(99);
+  CM_CHECK(rxRingEmpty(r));
+  CM_CHECK(!rxRingFull(r));
+  CM_CHECK_EQ(rxRingCount(r), 0);
+  CM_CHECK(!rxRingPop(r, m));
+  CM_CHECK_EQ(frameSeq(m), 99);  // untouched by a failed pop
+
+  // Emptied again after one frame
+  CM_CHECK(rxRingPush(r, frame(1)));
+  CM_CHECK(rxRingPop(r, m));
+  CM_CHECK(!rxRingPop(r, m));
+  CM_CHECK(rxRingEmpty(r));
+  CM_CHECK_EQ(r.dropped, 0);
+}
+
+static void testFull(CanRxRing& r) {
+  rxRingReset(r);
+  for (uint32_t i = 0; i < CM_RX_RING_SIZE; i++) CM_CHECK(rxRingPush(r, frame(i)));
+  CM_CHECK(rxRingFull(r));
+  CM_CHECK_EQ(rxRingCount(r), CM_RX_RING_SIZE);
+
+  // Pushing into a full ring drops the new frame and counts it, the ones already in stay
+  CM_CHECK(!rxRingPush(r, frame(1000)));
+  CM_CHECK(!rxRingPush(r, frame(1001)));
+  CM_CHECK_EQ(r.dropped, 2);
+  CM_CHECK_EQ(rxRingCount(r), CM_RX_RING_SIZE);
+
+  // One pop makes room for exactly one more
+  twai_message_t m{};
+  CM_CHECK(rxRingPop(r, m));
+  CM_CHECK_EQ(frameSeq(m), 0);
+  CM_CHECK(rxRingPush(r, frame(CM_RX_RING_SIZE)));
+  CM_CHECK(!rxRingPush(r, frame(1002)));
+  CM_CHECK_EQ(r.dropped, 3);
+
+  for (uint32_t i = 1; i <= CM_RX_RING_SIZE; i++) {
+    CM_CHECK(rxRingPop(r, m));
+    CM_CHECK_EQ(frameSeq(m), i);
+  }
+  CM_CHECK(rxRingEmpty(r));
+}
+
+// Three frames in flight while the buffer index goes round many times, then the same across the point where
+// head and tail overflow 16 bits
+static void testWrap(CanRxRing& r, uint16_t start) {
+  rxRingReset(r);
+  r.head.store(start);
+  r.tail.store(start);
+  uint32_t pushed = 0;
+  uint32_t popped = 0;
+  twai_message_t m{};
+  for (uint32_t round = 0; round < 10 * CM_RX_RING_SIZE; round++) {
+    while (pushed - popped < 3) CM_CHECK(rxRingPush(r, frame(pushed++)));
+    CM_CHECK_EQ(rxRingCount(r), 3);
+    CM_CHECK(rxRingPop(r, m));
+    CM_CHECK_EQ(frameSeq(m), popped++);
+  }
+  while (rxRingPop(r, m)) CM_CHECK_EQ(frameSeq(m), popped++);
+  CM_CHECK_EQ(popped, pushed);
+  CM_CHECK(rxRingEmpty(r));
+
+  // Filling it completely with the counters straddling the overflow
+  rxRingReset(r);
+  r.head.store(start);
+  r.tail.store(start);
+  for (uint32_t i = 0; i < CM_RX_RING_SIZE; i++) CM_CHECK(rxRingPush(r, frame(i)));
+  CM_CHECK(rxRingFull(r));
+  CM_CHECK(!rxRingPush(r, frame(1000)));
+  CM_CHECK_EQ(r.dropped, 1);
+  for (uint32_t i = 0; i < CM_RX_RING_SIZE; i++) {
+    CM_CHECK(rxRingPop(r, m));
+    CM_CHECK_EQ(frameSeq(m), i);
+  }
+  CM_CHECK(rxRingEmpty(r));
+}
+
+// Like the RX task and handleCAN(): every frame either arrives in order or is counted as dropped
+static void testThreads(CanRxRing& r) {
+  rxRingReset(r);
+  std::atomic<bool> done{false};
+  std::thread producer([&r, &done] {
+    for (uint32_t i = 0; i < TEST_THREAD_FRAMES; i++) rxRingPush(r, frame(i));
+    done.store(true);
+  });
+
+  uint32_t received = 0;
+  uint32_t last = 0;
+  bool ordered = true;
+  bool first = true;
+  twai_message_t m{};
+  while (!done.load() || !rxRingEmpty(r)) {
+    if (!rxRingPop(r, m)) continue;
+    uint32_t seq = frameSeq(m);
+    if ((!first && seq <= last) || m.identifier != (seq & 0x7FF)) ordered = false;
+    first = false;
+    last = seq;
+    received++;
+  }
+  producer.join();
+  CM_CHECK(ordered);
+  CM_CHECK_EQ(received + r.dropped, TEST_THREAD_FRAMES);
+}
+
+int main() {
+  static CanRxRing ring;
+  testEmpty(ring);
+  testFull(ring);
+  testWrap(ring, 0);
+  testWrap(ring, 0xFFFF - CM_RX_RING_SIZE / 2);
+  testThreads(ring);
+  return hostTestResult("rx_ring_test");
+}
@@ -0,0 +1,163 @@
+/**
+ * CAN MREX scheduler tests
+ *
+ * File:            SchedulerTest.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Steps a fake now through runScheduler() across the point where millis() wraps from 0xFFFFFFFF to 0 and
+ * checks timers fire in deadline order, never early and at most one step late, that periodic timers re-arming
+ * themselves keep their period through the wrap, and that re-arming, disarming and the per call cap behave.
+ * Runs on its own CanMrexNode, no bus is needed.
+ */
+
+#include "CM.h"
+#include "HostTest.h"
+
+#define TEST_WRAP  0u          // where millis() wraps
+#define TEST_STEP  7u          // ms between runScheduler() calls, not a divisor of any deadline below
+
+typedef struct {
+  uint16_t arg;
+  uint32_t now;
+} Firing;
+
+static Firing firings[256];
+static uint16_t firingCount;
+
+static void record(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  if (firingCount < 256) firings[firingCount++] = {arg, now};
+}
+
+// Steps now from start by TEST_STEP until it has moved span ms
+static void stepClock(uint32_t start, uint32_t span) {
+  for (uint32_t t = 0; t <= span; t += TEST_STEP) runScheduler(1, start + t);
+}
+
+// Deadlines on both sides of the wrap armed out of order fire in deadline order, in the first call at or
+// after their deadline
+static void testOrderAcrossWrap() {
+  resetScheduler();
+  firingCount = 0;
+  const uint32_t deadlines[] = {TEST_WRAP + 40, TEST_WRAP - 30, TEST_WRAP + 5, TEST_WRAP - 100, TEST_WRAP - 1,
+                                TEST_WRAP};
+  const uint16_t count = sizeof(deadlines) / sizeof(deadlines[0]);
+  for (uint16_t i = 0; i < count; i++) schedulerArm(schedulerCreateTimer(record, i), deadlines[i]);
+
+  uint32_t next = 0;
+  CM_CHECK(schedulerNextDeadline(&next));
+  CM_CHECK_EQ(next, TEST_WRAP - 100);
+
+  stepClock(TEST_WRAP - 200, 300);
+  CM_CHECK_EQ(firingCount, count);
+  const uint16_t expected[] = {3, 1, 4, 5, 2, 0};
+  for (uint16_t i = 0; i < firingCount && i < count; i++) {
+    CM_CHECK_EQ(firings[i].arg, expected[i]);
+    uint32_t late = firings[i].now - deadlines[firings[i].arg];  // wraps like millis()
+    CM_CHECK(late < TEST_STEP);
+  }
+  CM_CHECK(!schedulerNextDeadline(&next));
+}
+
+// Periodic timers that re-arm from their own deadline, as the TPDO event timers and heartbeat do
+typedef struct {
+  SchedTimer timer;
+  uint32_t period;
+  uint32_t deadline;
+  uint32_t fired;
+  uint32_t drift;  // largest gap between deadline and now seen
+} Periodic;
+
+static Periodic periodic[2];
+
+static void periodicFired(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  Periodic& p = periodic[arg];
+  uint32_t late = now - p.deadline;
+  if (late > p.drift) p.drift = late;
+  p.fired++;
+  p.deadline += p.period;
+  schedulerArm(p.timer, p.deadline);
+}
+
+static void testRearmAcrossWrap() {
+  resetScheduler();
+  const uint32_t start = TEST_WRAP - 1000;
+  const uint32_t periods[] = {10, 33};
+  for (uint16_t i = 0; i < 2; i++) {
+    periodic[i] = {schedulerCreateTimer(periodicFired, i), periods[i], start + periods[i], 0, 0};
+    schedulerArm(periodic[i].timer, periodic[i].deadline);
+  }
+  const uint32_t span = 286 * TEST_STEP;  // about 2 s, ending on a step
+  stepClock(start, span);
+
+  // Every deadline in the span fired, within one step of it, and the deadline never slipped
+  for (uint16_t i = 0; i < 2; i++) {
+    CM_CHECK_EQ(periodic[i].fired, span / periods[i]);
+    CM_CHECK(periodic[i].drift < TEST_STEP);
+    CM_CHECK_EQ(periodic[i].deadline, start + (periodic[i].fired + 1) * periods[i]);
+    CM_CHECK(schedulerArmed(periodic[i].timer));
+  }
+}
+
+// Moving a deadline across the wrap in either direction, and disarming
+static void testRearmAndDisarm() {
+  resetScheduler();
+  firingCount = 0;
+  SchedTimer later = schedulerCreateTimer(record, 0);
+  SchedTimer earlier = schedulerCreateTimer(record, 1);
+  SchedTimer dropped = schedulerCreateTimer(record, 2);
+  schedulerArm(later, TEST_WRAP - 20);
+  schedulerArm(earlier, TEST_WRAP + 50);
+  schedulerArm(dropped, TEST_WRAP + 10);
+  schedulerArm(later, TEST_WRAP + 80);    // pushed past the wrap
+  schedulerArm(earlier, TEST_WRAP - 40);  // pulled back before it
+  schedulerDisarm(dropped);
+  CM_CHECK(!schedulerArmed(dropped));
+
+  uint32_t next = 0;
+  CM_CHECK(schedulerNextDeadline(&next));
+  CM_CHECK_EQ(next, TEST_WRAP - 40);
+
+  stepClock(TEST_WRAP - 100, 200);
+  CM_CHECK_EQ(firingCount, 2);
+  if (firingCount == 2) {
+    CM_CHECK_EQ(firings[0].arg, 1);
+    CM_CHECK_EQ(firings[1].arg, 0);
+    CM_CHECK(firings[1].now - (TEST_WRAP + 80) < TEST_STEP);
+  }
+
+  // A deadline just before the wrap that now has already passed fires on the next call
+  firingCount = 0;
+  schedulerArm(dropped, TEST_WRAP - 1);
+  CM_CHECK_EQ(runScheduler(1, TEST_WRAP + 3), 1);
+  CM_CHECK_EQ(firingCount, 1);
+}
+
+// A callback that keeps re-arming at now is run at most CM_MAX_TIMERS times per call, not forever
+static SchedTimer spinner;
+
+static void spin(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  schedulerArm(spinner, now);
+}
+
+static void testRunCap() {
+  resetScheduler();
+  spinner = schedulerCreateTimer(spin, 0);
+  schedulerArm(spinner, TEST_WRAP - 1);
+  CM_CHECK_EQ(runScheduler(1, TEST_WRAP + 1), CM_MAX_TIMERS);
+  CM_CHECK(schedulerArmed(spinner));
+}
+
+int main() {
+  static CanMrexNode node;
+  cmSelectNode(&node);
+  testOrderAcrossWrap();
+  testRearmAcrossWrap();
+  testRearmAndDisarm();
+  testRunCap();
+  cmSelectNode(nullptr);
+  return hostTestResult("scheduler_test");
+}
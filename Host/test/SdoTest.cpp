@@ -0,0 +1,200 @@
+/**
+ * CAN MREX SDO round trip tests
+ *
+ * File:            SdoTest.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * A client and a server node on the simulated bus move an object with every SDO transfer type, in both
+ * directions, and the test checks the request finishes and the data arrives intact. The sizes make segmented
+ * transfers end on a partly filled segment and block transfers span more than one block. Requests the server
+ * can't serve are sent as raw frames and must be answered with the right abort code.
+ */
+
+#include <string.h>
+#include "TrainSim.h"
+#include "HostBus.h"
+#include "HostTest.h"
+
+#define TEST_SERVER_ID  1
+#define TEST_CLIENT_ID  2
+#define TEST_INDEX      0x2000
+#define TEST_MAX_BYTES  512
+#define TEST_LIMIT_MS   5000
+
+typedef enum : uint8_t {
+  TEST_EXPEDITED = 0,
+  TEST_SEGMENTED,
+  TEST_BLOCK
+} TestMode;
+
+typedef struct {
+  const char* name;
+  TestMode    mode;
+  bool        write;
+  uint16_t    bytes;
+  uint8_t     blockSize;   // block transfers only, set on both nodes
+} TestCase;
+
+static const TestCase cases[] = {
+  {"expedited write, 4 bytes",     TEST_EXPEDITED, true,  4,   0},
+  {"expedited read, 4 bytes",      TEST_EXPEDITED, false, 4,   0},
+  {"expedited write, 3 bytes",     TEST_EXPEDITED, true,  3,   0},
+  {"expedited read, 3 bytes",      TEST_EXPEDITED, false, 3,   0},
+  {"segmented write, 100 bytes",   TEST_SEGMENTED, true,  100, 0},
+  {"segmented read, 100 bytes",    TEST_SEGMENTED, false, 100, 0},
+  {"block write, 300 bytes",       TEST_BLOCK,     true,  300, 16},
+  {"block read, 300 bytes",        TEST_BLOCK,     false, 300, 16},
+  {"block write, 1 segment",       TEST_BLOCK,     true,  5,   4},
+  {"block read, 1 segment",        TEST_BLOCK,     false, 5,   4},
+};
+
+static const uint8_t NUM_CASES = sizeof(cases) / sizeof(cases[0]);
+
+static uint8_t serverObject[TEST_MAX_BYTES];
+static uint8_t clientObject[TEST_MAX_BYTES];
+
+static const TestCase* current;
+static SdoHandle handle;
+static SdoStatus result;
+static uint32_t resultValue;
+static bool submitted;
+
+static void serverSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  registerODEntry(TEST_INDEX, 1, 2, current->bytes, serverObject);
+  if (current->mode == TEST_BLOCK) setSDOBlockSize(current->blockSize);
+  nodeOperatingMode = 0x01;
+}
+
+static void serverLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+}
+
+static void clientSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+  if (current->mode == TEST_BLOCK) setSDOBlockSize(current->blockSize);
+  nodeOperatingMode = 0x01;
+}
+
+static SdoHandle startTransfer(uint8_t nodeID) {
+  const TestCase& tc = *current;
+  switch (tc.mode) {
+    case TEST_EXPEDITED:
+      if (tc.write) return sdoWriteAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1, tc.bytes, clientObject);
+      return sdoReadAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1);
+    case TEST_SEGMENTED:
+      if (tc.write) return sdoWriteAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1, tc.bytes, clientObject);
+      return sdoReadBufferAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1, clientObject, tc.bytes);
+    case TEST_BLOCK:
+      if (tc.write) return sdoBlockWriteAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1, tc.bytes, clientObject);
+      return sdoBlockReadAsync(nodeID, TEST_SERVER_ID, TEST_INDEX, 1, clientObject, tc.bytes);
+  }
+  return SDO_INVALID_HANDLE;
+}
+
+// Waits a few loops so the server is up, then starts one request and polls it to the end
+static void clientLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (result != SDO_PENDING || millis() < 20) return;
+  if (!submitted) {
+    submitted = true;
+    handle = startTransfer(nodeID);
+    if (handle == SDO_INVALID_HANDLE) result = SDO_ERROR;
+    return;
+  }
+  SdoStatus status = sdoPoll(handle, &resultValue);
+  if (status != SDO_PENDING) result = status;
+}
+
+static void runCase(uint8_t c) {
+  current = &cases[c];
+  for (uint16_t i = 0; i < TEST_MAX_BYTES; i++) {
+    serverObject[i] = (uint8_t)(i * 31 + c);
+    clientObject[i] = (uint8_t)(i * 17 + 5);
+  }
+  handle = SDO_INVALID_HANDLE;
+  result = SDO_PENDING;
+  resultValue = 0;
+  submitted = false;
+
+  simReset();
+  simAddNode({"Server", TEST_SERVER_ID, serverSetup, serverLoop, 250, 0});
+  simAddNode({"Client", TEST_CLIENT_ID, clientSetup, clientLoop, 250, 0});
+  for (uint32_t ms = 0; result == SDO_PENDING && ms < TEST_LIMIT_MS; ms += 10) simRun(10);
+
+  printf("%s\n", current->name);
+  CM_CHECK_EQ(result, SDO_DONE);
+  if (current->mode == TEST_EXPEDITED && !current->write) memcpy(clientObject, &resultValue, current->bytes);
+  else if (!current->write) CM_CHECK_EQ(resultValue, current->bytes);  // buffer reads report the byte count
+  CM_CHECK(memcmp(serverObject, clientObject, current->bytes) == 0);
+}
+
+typedef struct {
+  const char* name;
+  uint8_t     request[8];
+  uint32_t    abortCode;
+} AbortCase;
+
+static const AbortCase abortCases[] = {
+  {"read, no such object",         {0x40, 0x00, 0x20, 0x09, 0, 0, 0, 0},    SDO_ABORT_NO_OBJECT},
+  {"write, size not indicated",    {0x22, 0x00, 0x20, 0x01, 1, 2, 3, 4},    SDO_ABORT_COMMAND},
+  {"expedited write, wrong size",  {0x2B, 0x00, 0x20, 0x01, 1, 2, 0, 0},    SDO_ABORT_LENGTH},
+};
+
+static const uint8_t NUM_ABORT_CASES = sizeof(abortCases) / sizeof(abortCases[0]);
+
+static uint8_t abortSent;
+static twai_message_t abortResponses[NUM_ABORT_CASES];
+static uint8_t abortReceived;
+
+static void observeResponses(const twai_message_t& msg, uint8_t fromPort, void* arg) {
+  if (msg.identifier == 0x580 + TEST_SERVER_ID && abortReceived < NUM_ABORT_CASES) {
+    abortResponses[abortReceived++] = msg;
+  }
+}
+
+// Sends the next raw request once the previous one has been answered
+static void abortClientLoop(uint8_t nodeID) {
+  handleCAN(nodeID);
+  if (millis() < 20 || abortSent >= NUM_ABORT_CASES || abortReceived < abortSent) return;
+  twai_message_t msg{};
+  msg.identifier = 0x600 + TEST_SERVER_ID;
+  msg.data_length_code = 8;
+  memcpy(msg.data, abortCases[abortSent].request, 8);
+  if (queueCANTx(msg, CAN_TX_SDO)) abortSent++;
+}
+
+static void testServerAborts() {
+  static const TestCase object = {"abort server", TEST_EXPEDITED, true, 4, 0};
+  current = &object;
+  abortSent = 0;
+  abortReceived = 0;
+
+  simReset();
+  simAddNode({"Server", TEST_SERVER_ID, serverSetup, serverLoop, 250, 0});
+  simAddNode({"Client", TEST_CLIENT_ID, clientSetup, abortClientLoop, 250, 0});
+  hostBusSetObserver(observeResponses, nullptr);
+  for (uint32_t ms = 0; abortReceived < NUM_ABORT_CASES && ms < TEST_LIMIT_MS; ms += 10) simRun(10);
+  hostBusSetObserver(nullptr, nullptr);
+
+  CM_CHECK_EQ(abortReceived, NUM_ABORT_CASES);
+  for (uint8_t c = 0; c < abortReceived; c++) {
+    const twai_message_t& r = abortResponses[c];
+    uint32_t code;
+    memcpy(&code, &r.data[4], 4);
+    printf("%s\n", abortCases[c].name);
+    CM_CHECK_EQ(r.data[0], 0x80);
+    CM_CHECK(memcmp(&r.data[1], &abortCases[c].request[1], 3) == 0);  // index and subindex echoed
+    CM_CHECK_EQ(code, abortCases[c].abortCode);
+  }
+}
+
+int main() {
+  for (uint8_t c = 0; c < NUM_CASES; c++) runCase(c);
+  testServerAborts();
+  return hostTestResult("sdo_test");
+}
@@ -0,0 +1,63 @@
+/**
+ * CAN MREX transmit rate tests
+ *
+ * File:            TxRateTest.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * The priority queues only feed the driver from handleCAN(), and the driver holds CM_TWAI_TX_QUEUE_LEN frames
+ * plus the one in the controller. A node that always has frames waiting therefore sends at most
+ * CM_TWAI_TX_QUEUE_LEN + 1 frames per pass of its loop. Runs one such node at a slow and a fast loop period and
+ * checks the slow one is capped per loop while the fast one fills the bus.
+ */
+
+#include "TrainSim.h"
+#include "HostTest.h"
+
+#define TEST_NODE_ID  4
+#define TEST_COB      0x184
+#define TEST_RUN_MS   100
+#define TEST_SLOW_US  1000   // longer than CM_TWAI_TX_QUEUE_LEN + 1 frames take on the bus
+#define TEST_FAST_US  50     // shorter than one frame
+
+static void nodeSetup(uint8_t nodeID) {
+  initCANMREX(GPIO_NUM_5, GPIO_NUM_4, nodeID);
+}
+
+// Keeps the PDO queue full, as a node with more to send than its loop rate allows would
+static void nodeLoop(uint8_t nodeID) {
+  twai_message_t msg{};
+  msg.identifier = TEST_COB;
+  msg.data_length_code = 8;
+  while (getCANTxSpace(CAN_TX_PDO) > 0) queueCANTx(msg, CAN_TX_PDO);
+  handleCAN(nodeID);
+}
+
+static uint32_t runAt(uint32_t loopUs, float* load) {
+  simReset();
+  simAddNode({"Sender", TEST_NODE_ID, nodeSetup, nodeLoop, loopUs, 0});
+  simRun(TEST_RUN_MS);
+  *load = simBusStats().load;
+  const SimCobStats* s = simCobStats(TEST_COB);
+  return s != nullptr ? s->frames : 0;
+}
+
+int main() {
+  float slowLoad = 0;
+  float fastLoad = 0;
+  uint32_t slow = runAt(TEST_SLOW_US, &slowLoad);
+  uint32_t fast = runAt(TEST_FAST_US, &fastLoad);
+  uint32_t loops = TEST_RUN_MS * 1000 / TEST_SLOW_US + 1;
+  printf("%u us loop: %u frames, load %.1f %%\n", TEST_SLOW_US, slow, slowLoad * 100);
+  printf("%u us loop: %u frames, load %.1f %%\n", TEST_FAST_US, fast, fastLoad * 100);
+
+  // The slow loop gets exactly what the driver holds each pass, the fast one is limited by the bus instead
+  CM_CHECK(slow <= loops * (CM_TWAI_TX_QUEUE_LEN + 1));
+  CM_CHECK(slow + 2 * (CM_TWAI_TX_QUEUE_LEN + 1) >= loops * (CM_TWAI_TX_QUEUE_LEN + 1));
+  CM_CHECK(fast > slow);
+  CM_CHECK(fastLoad > 0.9f);
+  return hostTestResult("tx_rate_test");
+}
@@ -36,7 +36,7 @@ uint16_t power_magnitude = 0; // Instantenous Power
 uint16_t state_of_charge = 0; // 0-100%. +/- 0.1%. If the SOC is 88.3% it is sent as 883 so 16 bits enough.
 uint8_t Ah_sign = 0; // 1 byte to indicate sign of Ah consumption. 
 uint32_t Amp_hours_consumed_magnitude = 0; 
-unit8_t recovered_energy_sign = 0;
+uint8_t recovered_energy_sign = 0;
 uint32_t recovered_energy = 0; // how much energy was recovered from regenerative braking
 // variables not for OD
 int32_t ce = 0;
@@ -78,7 +78,7 @@ void setup() {
   registerODEntry(0x2000, 0x06, 0, sizeof(power_sign), &power_sign); 
   registerODEntry(0x2000, 0x07, 0, sizeof(power_magnitude), &power_magnitude);
   registerODEntry(0x2000, 0x08, 0, sizeof(recovered_energy_sign), &recovered_energy_sign);
-  registerODEntry(0x2000, 0x08, 0, sizeof(recovered_energy), &recovered_energy);
+  registerODEntry(0x2000, 0x09, 0, sizeof(recovered_energy), &recovered_energy);
 
 
   configureTPDO(0, 0x180 + nodeID, 255, 100, 1000);  // TPDO 1, COB-ID, transType, inhibit, event
@@ -107,7 +107,7 @@ void setup() {
 
     mapTPDO(0, tpdoEntries1, 3); //TPDO 1, entries, num entries
     mapTPDO(1, tpdoEntries2, 3); //TPDO 2, entries, num entries
-    mapTPDO(2, tpdoEntries3, 2); //TPDO 3, entries, num entries
+    mapTPDO(2, tpdoEntries3, 4); //TPDO 3, entries, num entries
 
   // --- Register RPDOs ---
   // This node simply puts the sensor values on the can bus. Only TPDOs need to be configured
@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    13/09/2025
- * Last Modified:   13/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -19,10 +19,15 @@
 #include "CM_Handler.h"
 #include "CM_SDO.h"
 #include "CM_ObjectDictionary.h"
+#include "CM_ODTable.h"
 #include "CM_PDO.h"
 #include "CM_Config.h"
 #include "CM_Heartbeat.h"
 #include "CM_NMT.h"
+#include "CM_SYNC.h"
 #include "CM_EMCY.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
 
 #endif
\ No newline at end of file
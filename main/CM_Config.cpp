@@ -5,40 +5,54 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    9/09/2025
- * Last Modified:   12/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
 
 #include "driver/twai.h"
+#include "CM_Config.h"
 #include "CM_ObjectDictionary.h"
 #include "CM_PDO.h"
+#include "CM_Handler.h"
+#include "CM_Scheduler.h"
+#include "CM_Heartbeat.h"
+#include "CM_SYNC.h"
+#include "CM_TxQueue.h"
+#include "CM_SDO.h"
+#include "CM_Node.h"
 
 
 void initCANMREX(gpio_num_t TX_GPIO_NUM, gpio_num_t RX_GPIO_NUM, uint8_t nodeID){
+  ConfigNodeState& cfg = cmNode->config;
+  cmNode->nodeID = nodeID;
   Serial.println("CAN MREX intialising over (TWAI)");
 
   // General configuration
-  twai_general_config_t g_config = {
+  cfg.g_config = {
     .mode = TWAI_MODE_NORMAL,
     .tx_io = TX_GPIO_NUM,
     .rx_io = RX_GPIO_NUM,
     .clkout_io = TWAI_IO_UNUSED,
     .bus_off_io = TWAI_IO_UNUSED,
-    .tx_queue_len = 5,
-    .rx_queue_len = 5,
+    .tx_queue_len = CM_TWAI_TX_QUEUE_LEN,
+    .rx_queue_len = CM_TWAI_RX_QUEUE_LEN,
+    .alerts_enabled = TWAI_ALERT_NONE,
     .clkout_divider = 0,
     .intr_flags = ESP_INTR_FLAG_LEVEL1
   };
 
   // Timing configuration for 500 kbps
-  twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
+  cfg.t_config = TWAI_TIMING_CONFIG_500KBITS();
 
-  //Set filter for hardware filtering
-  twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+  //Accept everything until the configuration is known, the real filter is applied from handleCAN()
+  cfg.f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+  cfg.extraFilterCount = 0;
+  cfg.acceptAllSDOResponses = CM_FILTER_SDO_RESPONSES;
+  cfg.filterReport = {true, cfg.f_config.acceptance_code, cfg.f_config.acceptance_mask, 0, 2048, 0.0f};
 
   // Install and start TWAI driver
-  if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
+  if (twai_driver_install(&cfg.g_config, &cfg.t_config, &cfg.f_config) != ESP_OK) {
     Serial.println("TWAI driver install failed");
     while (true); // blink an led perhaps to show problem
   }
@@ -47,6 +61,13 @@ void initCANMREX(gpio_num_t TX_GPIO_NUM, gpio_num_t RX_GPIO_NUM, uint8_t nodeID)
     while (true); // blink an led perhaps to show problem
   }
 
+#if CM_USE_RX_TASK
+  // Drain the TWAI queue from its own task so handleCAN() never blocks
+  if (!startCANRxTask()) {
+    Serial.println("CAN MREX receive task failed to start, polling instead");
+  }
+#endif
+
   //OPTIONAL: Debugging can be put in when needed
   // uint32_t alerts_to_enable = TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_TX_IDLE | TWAI_ALERT_BUS_ERROR;
   // if (twai_reconfigure_alerts(alerts_to_enable, NULL) == ESP_OK) {
@@ -55,6 +76,18 @@ void initCANMREX(gpio_num_t TX_GPIO_NUM, gpio_num_t RX_GPIO_NUM, uint8_t nodeID)
   //   Serial.println("Failed to reconfigure alerts");
   // }
 
+  //Route the always-on services, PDOs and heartbeats are added as they are configured
+  resetCANDispatch();
+  setCANDispatch(0x000, CAN_DISPATCH_NMT);
+  for (uint16_t cob = 0x081; cob <= 0x0FF; cob++) setCANDispatch(cob, CAN_DISPATCH_EMCY);
+  setCANDispatch(0x600 + nodeID, CAN_DISPATCH_SDO_SERVER);
+
+  //Software transmit queues
+  resetCANTx();
+
+  //Periodic services (TPDO timers, heartbeat) register with the scheduler below
+  resetScheduler();
+
   //Initializes all TPDOs and RPDOs as disabled and clears runtime state
   Serial.println("Initialising Default PDOs");
   initDefaultPDOs(nodeID);
@@ -63,5 +96,178 @@ void initCANMREX(gpio_num_t TX_GPIO_NUM, gpio_num_t RX_GPIO_NUM, uint8_t nodeID)
   Serial.println("Initialising Default Object Dictionary");
   initDefaultOD();
 
+  //Start producing heartbeats
+  initHeartbeat();
+
+  //Consume SYNC, the master also calls setupSyncProducer()
+  initSYNC();
+
+
+ }
+
+
+
+// --- Acceptance filter ---
+// A run of consecutive consumed COB-IDs is reduced to the bits that are fixed (AND) and the bits set anywhere (OR)
+typedef struct {
+  uint16_t lo;
+  uint16_t hi;
+} IdRun;
+
+static void runBits(const IdRun& r, uint16_t& andBits, uint16_t& orBits) {
+  uint16_t diff = r.lo ^ r.hi;
+  uint16_t low = 0;
+  while (diff) { low = (low << 1) | 1; diff >>= 1; } // every bit at or below the highest differing bit varies
+  andBits = r.lo & ~low;
+  orBits = r.lo | low;
+}
+
+// Number of IDs matched by a code/mask pair covering runs [first, last]
+static uint16_t groupCost(const IdRun* runs, uint8_t first, uint8_t last, uint16_t& code, uint16_t& dontCare) {
+  uint16_t andAll = 0x7FF, orAll = 0;
+  for (uint8_t i = first; i <= last; i++) {
+    uint16_t a, o;
+    runBits(runs[i], a, o);
+    andAll &= a;
+    orAll |= o;
+  }
+  code = andAll;
+  dontCare = (andAll ^ orAll) & 0x7FF;
+  return 1u << __builtin_popcount(dontCare);
+}
+
+// Collects consumed COB-IDs as sorted runs, merging the closest runs if there are too many
+static uint8_t collectRuns(IdRun* runs) {
+  ConfigNodeState& cfg = cmNode->config;
+  uint8_t count = 0;
+  for (uint16_t id = 0; id < 2048; id++) {
+    uint8_t kind = getCANDispatchKind(id);
+    bool used = kind != CAN_DISPATCH_NONE && kind != CAN_DISPATCH_SDO_CLIENT;
+    for (uint8_t i = 0; i < cfg.extraFilterCount && !used; i++) used = cfg.extraFilterIDs[i] == id;
+    if (cfg.acceptAllSDOResponses && id > 0x580 && id <= 0x5FF) used = true;
+    if (!used) continue;
+    if (count > 0 && runs[count - 1].hi + 1 == id) { runs[count - 1].hi = id; continue; }
+    if (count == CM_FILTER_MAX_RUNS) { // out of space, fold into the last run
+      runs[count - 1].hi = id;
+      continue;
+    }
+    runs[count++] = {id, id};
+  }
+  return count;
+}
+
+static bool filterMatches(const twai_filter_config_t& f, uint16_t id) {
+  bool f1 = ((((uint32_t)id << 21) ^ f.acceptance_code) & ~f.acceptance_mask & 0xFFE00000u) == 0;
+  bool f2 = ((((uint32_t)id << 5) ^ f.acceptance_code) & ~f.acceptance_mask & 0x0000FFE0u) == 0;
+  return f.single_filter ? f1 : (f1 || f2);
+}
+
+// Picks the single or dual filter that lets the fewest unused IDs through
+static twai_filter_config_t computeCANFilter(uint16_t& consumed) {
+  static IdRun runs[CM_FILTER_MAX_RUNS];
+  uint8_t count = collectRuns(runs);
+  consumed = 0;
+  for (uint8_t i = 0; i < count; i++) consumed += runs[i].hi - runs[i].lo + 1;
+  if (count == 0) return TWAI_FILTER_CONFIG_ACCEPT_ALL();
+
+  uint16_t code, dontCare;
+  uint16_t best = groupCost(runs, 0, count - 1, code, dontCare);
+  twai_filter_config_t f;
+  f.single_filter = true;
+  f.acceptance_code = (uint32_t)code << 21;
+  f.acceptance_mask = ((uint32_t)dontCare << 21) | 0x001FFFFFu; // RTR and data bytes are don't care
+
+  // Dual filter: try every split of the sorted runs into two groups
+  for (uint8_t split = 0; split + 1 < count; split++) {
+    uint16_t code1, dc1, code2, dc2;
+    uint32_t cost = groupCost(runs, 0, split, code1, dc1) + groupCost(runs, split + 1, count - 1, code2, dc2);
+    if (cost < best) {
+      best = cost;
+      f.single_filter = false;
+      f.acceptance_code = ((uint32_t)code1 << 21) | ((uint32_t)code2 << 5);
+      f.acceptance_mask = ((uint32_t)dc1 << 21) | ((uint32_t)dc2 << 5) | 0x001F001Fu;
+    }
+  }
+  return f;
+}
+
+void markCANFiltersDirty() {
+  cmNode->config.canFiltersDirty = true;
+}
+
+// True when reinstalling the driver can't lose anything: nothing waiting to be sent, nothing received but not yet
+// handled (driver queue, RX ring or left over from the batch budget) and no SDO response expected
+static bool canFiltersQuiescent() {
+  CanTxStats tx = getCANTxStats();
+  for (uint8_t c = 0; c < CAN_TX_CLASSES; c++) {
+    if (tx.depth[c] > 0) return false;
+  }
+  twai_status_info_t status;
+  if (twai_get_status_info(&status) != ESP_OK || status.msgs_to_tx > 0 || status.msgs_to_rx > 0) return false;
+  if (pendingCANFrames() > 0) return false;
+  return sdoPendingCount() == 0;
+}
+
+// Called from handleCAN() after the transmit queues are serviced, reinstalls the filter once the configuration has
+// changed and the node is quiescent
+void serviceCANFilters() {
+  ConfigNodeState& cfg = cmNode->config;
+#if CM_USE_HW_FILTER
+  if (cfg.canFiltersDirty && canFiltersQuiescent()) applyCANFilters();
+#endif
+}
+
+// Recomputes the acceptance filter and reinstalls the driver with it (the TWAI filter can only be set at install)
+bool applyCANFilters() {
+  ConfigNodeState& cfg = cmNode->config;
+  cfg.canFiltersDirty = false;
+  uint16_t consumed = 0;
+  twai_filter_config_t f = computeCANFilter(consumed);
+
+  if (f.acceptance_code != cfg.f_config.acceptance_code || f.acceptance_mask != cfg.f_config.acceptance_mask ||
+      f.single_filter != cfg.f_config.single_filter) {
+    pauseCANRxTask();
+    twai_stop();
+    twai_driver_uninstall();
+    bool ok = twai_driver_install(&cfg.g_config, &cfg.t_config, &f) == ESP_OK && twai_start() == ESP_OK;
+    if (!ok) { // fall back to the previous filter so the node stays on the bus
+      Serial.println("Error 0x00000501: TWAI filter reinstall failed");
+      twai_driver_install(&cfg.g_config, &cfg.t_config, &cfg.f_config);
+      twai_start();
+      resumeCANRxTask();
+      return false;
+    }
+    cfg.f_config = f;
+    resumeCANRxTask();
+  }
+
+  uint16_t accepted = 0;
+  for (uint16_t id = 0; id < 2048; id++) {
+    if (filterMatches(cfg.f_config, id)) accepted++;
+  }
+  cfg.filterReport = {(bool)cfg.f_config.single_filter, cfg.f_config.acceptance_code, cfg.f_config.acceptance_mask, consumed, accepted,
+                  1.0f - accepted / 2048.0f};
+  return true;
+}
+
+bool canFilterAccepts(uint16_t cobID) {
+  return filterMatches(cmNode->config.f_config, cobID);
+}
+
+// Adds a COB-ID outside the dispatch table (e.g. an SDO server response) to the filter. Only marks the filter dirty,
+// so it gets through once handleCAN() next reinstalls it. Call it during setup for IDs needed straight away
+void ensureCANFilterAccepts(uint16_t cobID) {
+  ConfigNodeState& cfg = cmNode->config;
+#if CM_USE_HW_FILTER
+  for (uint8_t i = 0; i < cfg.extraFilterCount; i++) {
+    if (cfg.extraFilterIDs[i] == cobID) return;
+  }
+  if (cfg.extraFilterCount < MAX_EXTRA_FILTER_IDS) cfg.extraFilterIDs[cfg.extraFilterCount++] = cobID;
+  else cfg.acceptAllSDOResponses = true;
+  if (!canFilterAccepts(cobID)) markCANFiltersDirty();
+#endif
+}
 
- }
\ No newline at end of file
+CanFilterReport getCANFilterReport() {
+  return cmNode->config.filterReport;
+}
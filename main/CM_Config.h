@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    9/09/2025
- * Last Modified:   9/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -16,8 +16,65 @@
 #include <Arduino.h>
 #include "driver/twai.h"
 
+// TWAI driver queue depths
+#ifndef CM_TWAI_RX_QUEUE_LEN
+#define CM_TWAI_RX_QUEUE_LEN 32
+#endif
+#ifndef CM_TWAI_TX_QUEUE_LEN
+#define CM_TWAI_TX_QUEUE_LEN 1   // Kept short, frames wait in the priority queues in CM_TxQueue instead
+#endif
+// The priority queues are only moved into the driver from handleCAN(), so a node sends at most
+// CM_TWAI_TX_QUEUE_LEN + 1 frames (queue plus controller buffer) per call: about 2 per loop by default
+
+// Hardware acceptance filter derived from the COB-IDs this node consumes
+#ifndef CM_USE_HW_FILTER
+#define CM_USE_HW_FILTER 1
+#endif
+#ifndef CM_FILTER_SDO_RESPONSES
+#define CM_FILTER_SDO_RESPONSES 1 // Let every SDO response (0x581-0x5FF) through, 0 on nodes that are never a client
+#endif
+#ifndef CM_FILTER_MAX_RUNS
+#define CM_FILTER_MAX_RUNS 32    // Consecutive COB-ID ranges tracked when choosing the filter
+#endif
+
+typedef struct {
+  bool     singleFilter;     // false = dual filter mode
+  uint32_t acceptanceCode;
+  uint32_t acceptanceMask;
+  uint16_t consumedIDs;      // COB-IDs the node actually handles
+  uint16_t acceptedIDs;      // COB-IDs the filter lets through (>= consumedIDs)
+  float    rejectedFraction; // estimated share of bus traffic dropped in hardware, assuming IDs are equally likely
+} CanFilterReport;
+
+// COB-IDs accepted on top of the dispatch table (SDO servers we talk to as a client)
+#define MAX_EXTRA_FILTER_IDS 16
+
+// Per node driver configuration and filter state, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  twai_general_config_t g_config;
+  twai_timing_config_t t_config;
+  twai_filter_config_t f_config;
+
+  bool canFiltersDirty;
+  CanFilterReport filterReport;
+
+  uint16_t extraFilterIDs[MAX_EXTRA_FILTER_IDS];
+  uint8_t extraFilterCount;
+  bool acceptAllSDOResponses; // CM_FILTER_SDO_RESPONSES, or set once extraFilterIDs is full
+} ConfigNodeState;
+
 
 void initCANMREX(gpio_num_t TX_GPIO_NUM, gpio_num_t RX_GPIO_NUM, uint8_t nodeID);
 
+// Filters are recomputed and reinstalled from handleCAN() whenever the consumed COB-IDs change. Reinstalling the
+// driver drops the frames in its queues, so handleCAN() waits until the transmit queues are empty, no received frame
+// is waiting and no SDO request is outstanding. applyCANFilters() reinstalls straight away
+void markCANFiltersDirty();
+void serviceCANFilters();
+bool applyCANFilters();
+bool canFilterAccepts(uint16_t cobID);
+void ensureCANFilterAccepts(uint16_t cobID);
+CanFilterReport getCANFilterReport();
+
 
 #endif
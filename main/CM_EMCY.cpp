@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    12/09/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -14,13 +14,14 @@
 #include <Arduino.h>
 #include "CM_ObjectDictionary.h"
 #include "CM_EMCY.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
 
 const uint8_t MAX_MINOR_EMCY_COUNT = 5;
-uint8_t minorEMCYCount = 0;
 
 void handleEMCY(const twai_message_t& rxMsg, uint8_t nodeID){
-  if (rxMsg.data[0] == 0x00) nodeOperatingMode = 0x02;
-  if (rxMsg.data[0] == 0x01) minorEMCYCount += 1;
+  if (rxMsg.data[0] == 0x00) cmOperatingMode() = 0x02;
+  if (rxMsg.data[0] == 0x01) cmNode->minorEMCYCount += 1;
 }
 
 
@@ -29,6 +30,7 @@ void sendEMCY(uint8_t priority, uint8_t nodeID, uint32_t errorCode){
   twai_message_t txMsg;
   txMsg.identifier = 0x080 + nodeID;
   txMsg.data_length_code = 6;
+  txMsg.flags = TWAI_MSG_FLAG_NONE;
   txMsg.data[0] = priority;
   txMsg.data[1] = nodeID;
   txMsg.data[2] = errorCode & 0xFF;
@@ -37,22 +39,21 @@ void sendEMCY(uint8_t priority, uint8_t nodeID, uint32_t errorCode){
   txMsg.data[5] = (errorCode >> 24) & 0xFF;
 
   if (priority == 0x00) {
-    nodeOperatingMode = 0x02;  // Stop system
+    cmOperatingMode() = 0x02;  // Stop system
   }
 
   if (priority == 0x01) {
-    minorEMCYCount += 1;
-    if (minorEMCYCount >= MAX_MINOR_EMCY_COUNT) {
-      minorEMCYCount = 0;  // Reset to avoid infinite loop
+    cmNode->minorEMCYCount += 1;
+    if (cmNode->minorEMCYCount >= MAX_MINOR_EMCY_COUNT) {
+      cmNode->minorEMCYCount = 0;  // Reset to avoid infinite loop
       sendEMCY(0x00, nodeID, 0x00000301);  // Major EMCY
       return;
     }
   }
 
-  if (twai_transmit(&txMsg, pdMS_TO_TICKS(100)) != ESP_OK) {
-    if (twai_transmit(&txMsg, pdMS_TO_TICKS(100)) != ESP_OK) {
-      Serial.println("EMCY transmission failed twice");
-    }
+  // Highest priority class, goes out ahead of anything else waiting to be sent
+  if (!queueCANTx(txMsg, CAN_TX_EMCY)) {
+    Serial.println("EMCY transmission failed, transmit queue full");
   }
 }
 
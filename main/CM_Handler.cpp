@@ -6,7 +6,7 @@
 
  * Author:          Chiara Gillam
  * Date Created:    6/08/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -20,51 +20,167 @@
 #include "CM_NMT.h"
 #include "CM_EMCY.h"
 #include "CM_Heartbeat.h"
+#include "CM_SYNC.h"
+#include "CM_RxRing.h"
+#include "CM_Config.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
 
-void handleCAN(uint8_t nodeID, twai_message_t* pdoMsg) {
-  if(nodeOperatingMode == 0x01){ 
-    serviceTPDOs(nodeID); // Handles all TPDOs to be sent if in operational mode
-  }
-  sendHeartbeat(nodeID); //sends Heartbeat periodically
-  // checkHeartbeatTimeouts(); // Checks heartbeats to make sure they're not overdue (Heartbeat consumer only)
+void resetCANDispatch() {
+  HandlerNodeState& h = cmNode->handler;
+  memset(h.canDispatch, 0, sizeof(h.canDispatch));
+  markCANFiltersDirty();
+}
 
-  // Receive the message
-  twai_message_t rxMsg;
-  if (pdoMsg == nullptr) {
-    if (twai_receive(&rxMsg, pdMS_TO_TICKS(5)) != ESP_OK) return; // Timeout or error
-  } else {
-    rxMsg = *pdoMsg;
+void setCANDispatch(uint16_t cobID, uint8_t kind, uint16_t channel) {
+  HandlerNodeState& h = cmNode->handler;
+  if (cobID >= CAN_DISPATCH_SIZE) return;
+  if (kind != CAN_DISPATCH_SDO_CLIENT) markCANFiltersDirty(); // SDO client IDs are handled by ensureCANFilterAccepts()
+  h.canDispatch[cobID] = ((uint16_t)kind << 12) | (channel & 0x0FFF);
+}
+
+void clearCANDispatch(uint16_t cobID) {
+  HandlerNodeState& h = cmNode->handler;
+  if (cobID >= CAN_DISPATCH_SIZE) return;
+  if ((h.canDispatch[cobID] >> 12) != CAN_DISPATCH_SDO_CLIENT) markCANFiltersDirty();
+  h.canDispatch[cobID] = 0;
+}
+
+uint8_t getCANDispatchKind(uint16_t cobID) {
+  HandlerNodeState& h = cmNode->handler;
+  if (cobID >= CAN_DISPATCH_SIZE) return CAN_DISPATCH_NONE;
+  return h.canDispatch[cobID] >> 12;
+}
+
+// Receive task: waits on the TWAI queue and hands every frame to handleCAN() through the ring.
+// The wait is bounded so the task can park itself while the driver is reinstalled. Only pauseCANRxTask() clears
+// rxTaskPaused; the task sets it and loops back to re-check the request before it touches the driver again
+static void canRxTask(void* arg) {
+  HandlerNodeState& h = static_cast<CanMrexNode*>(arg)->handler;
+  twai_message_t msg;
+  for (;;) {
+    if (h.rxPauseRequested.load()) {
+      h.rxTaskPaused.store(true);
+      vTaskDelay(1);
+      continue;
+    }
+    if (twai_receive(&msg, pdMS_TO_TICKS(CM_RX_TASK_WAIT_MS)) == ESP_OK) {
+      rxRingPush(h.canRxRing, msg);
+    }
   }
+}
 
-  // Handle the message
-  uint32_t canID = rxMsg.identifier;
+bool startCANRxTask() {
+  HandlerNodeState& h = cmNode->handler;
+  if (h.canRxTaskHandle != nullptr) return true;
+  rxRingReset(h.canRxRing);
+  return xTaskCreatePinnedToCore(canRxTask, "CM_RX", CM_RX_TASK_STACK, cmNode,
+                                 CM_RX_TASK_PRIORITY, &h.canRxTaskHandle, CM_RX_TASK_CORE) == pdPASS;
+}
 
-  if (canID == 0x000) { // NMT commands (always processed)
-    handleNMT(rxMsg, nodeID);
-    return;
-  } 
-  else if (canID >= 0x081 && canID <= 0x0FF) { // Emergency messages (always processed)
-    handleEMCY(rxMsg, nodeID);
-    return;
-  } 
-  else if ((canID >= 0x180 && canID <= 0x57F) && nodeOperatingMode == 0x01) { // RPDOs (only in operational state)
-    processRPDO(rxMsg, nodeID);
-    return;
-  } 
-  else if (canID == 0x600 + nodeID && (nodeOperatingMode == 0x01 || nodeOperatingMode == 0x80)) {
-  handleSDO(rxMsg, nodeID);
-  return;
-  } 
-  // else if (canID >= 0x700 && canID <= 0x780) { // Heartbeats
-  //   receiveHeartbeat(rxMsg);
-  //   return;
-  // } // For heartbeat consumer only
-  else {
-    return;
+// Stops the receive task from touching the driver (e.g. while filters are reinstalled)
+void pauseCANRxTask() {
+  HandlerNodeState& h = cmNode->handler;
+  if (h.canRxTaskHandle == nullptr) return;
+  h.rxTaskPaused.store(false);  // drop the acknowledgement of any earlier pause before asking again
+  h.rxPauseRequested.store(true);
+  while (!h.rxTaskPaused.load()) vTaskDelay(1);
+}
+
+void resumeCANRxTask() {
+  cmNode->handler.rxPauseRequested.store(false);
+}
+
+// Takes the next received frame, waiting up to timeoutMs (0 = don't wait)
+bool receiveCANFrame(twai_message_t* msg, uint32_t timeoutMs) {
+  HandlerNodeState& h = cmNode->handler;
+  if (h.canRxTaskHandle == nullptr) {
+    return twai_receive(msg, pdMS_TO_TICKS(timeoutMs)) == ESP_OK;
+  }
+  uint32_t start = millis();
+  while (!rxRingPop(h.canRxRing, *msg)) {
+    if (millis() - start >= timeoutMs) return false;
+    vTaskDelay(1);
   }
+  return true;
 }
 
+// Frames waiting in the ring (RX task) or in the driver queue (polling)
+uint16_t pendingCANFrames() {
+  HandlerNodeState& h = cmNode->handler;
+  if (h.canRxTaskHandle != nullptr) return rxRingCount(h.canRxRing);
+  twai_status_info_t status;
+  if (twai_get_status_info(&status) != ESP_OK) return 0;
+  return status.msgs_to_rx;
+}
 
+uint32_t getCANRxDropped() {
+  return cmNode->handler.canRxRing.dropped;
+}
 
+// Routes one frame to its handler using the dispatch table
+static void dispatchCANFrame(const twai_message_t& rxMsg, uint8_t nodeID) {
+  HandlerNodeState& h = cmNode->handler;
+  if (rxMsg.extd) return; // CAN MREX only uses 11-bit identifiers
+  uint16_t entry = h.canDispatch[rxMsg.identifier & 0x7FF];
+  uint16_t channel = entry & 0x0FFF;
 
+  switch (entry >> 12) {
+    case CAN_DISPATCH_NMT: // NMT commands (always processed)
+      handleNMT(rxMsg, nodeID);
+      break;
+    case CAN_DISPATCH_EMCY: // Emergency messages (always processed)
+      handleEMCY(rxMsg, nodeID);
+      break;
+    case CAN_DISPATCH_RPDO: // RPDOs (only in operational state)
+      if (cmOperatingMode() == 0x01) processRPDO(rxMsg, nodeID, channel);
+      break;
+    case CAN_DISPATCH_SDO_SERVER:
+      if (cmOperatingMode() == 0x01 || cmOperatingMode() == 0x80) handleSDO(rxMsg, nodeID);
+      break;
+    case CAN_DISPATCH_SDO_CLIENT: // Responses to our own SDO requests
+      handleSDOResponse(rxMsg, nodeID, channel);
+      break;
+    case CAN_DISPATCH_HEARTBEAT: // Heartbeat consumer only
+      receiveHeartbeat(rxMsg);
+      break;
+    case CAN_DISPATCH_SYNC: // Synchronous PDOs only act on it while operational
+      handleSYNC(rxMsg, nodeID);
+      break;
+    default:
+      break;
+  }
+}
 
+// Services periodic sends then handles up to budget pending frames
+CanBatchResult handleCANBatch(uint8_t nodeID, uint16_t budget) {
+  serviceTPDOs(nodeID); // Re-arms TPDOs when the node becomes operational
+  runScheduler(nodeID, millis()); // TPDO event timers, heartbeat and other periodic services that are due
+  serviceSDOClient(nodeID); // Times out outstanding SDO requests and sends block write segments
+  serviceSDOServer(nodeID); // Sends block upload segments
+  serviceCANTx(); // Feeds queued frames to the driver as hardware slots free up
+
+  CanBatchResult result = {0, 0};
+  twai_message_t rxMsg;
+  while (result.handled < budget && receiveCANFrame(&rxMsg, 0)) {
+    dispatchCANFrame(rxMsg, nodeID);
+    result.handled++;
+  }
+  serviceCANTx();
+  serviceCANFilters(); // Reapplies the acceptance filter after the consumed COB-IDs change, once nothing is in flight
+  result.pending = pendingCANFrames();
+  return result;
+}
+
+void handleCAN(uint8_t nodeID, twai_message_t* pdoMsg) {
+  if (pdoMsg != nullptr) { // Frame already received by the caller
+    serviceTPDOs(nodeID);
+    runScheduler(nodeID, millis());
+    dispatchCANFrame(*pdoMsg, nodeID);
+    serviceCANTx(); // Sends whatever handling the frame queued
+    return;
+  }
+
+  handleCANBatch(nodeID, CM_RX_BATCH_BUDGET);
+}
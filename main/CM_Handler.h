@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    6/08/2025
- * Last Modified:   12/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -16,7 +16,76 @@
 
 #include <Arduino.h>
 #include "driver/twai.h"
+#include <atomic>
+#include "CM_RxRing.h"
+
+// Receive task configuration. When enabled initCANMREX() starts a task that drains the TWAI
+// queue into a lock-free ring, otherwise handleCAN() polls the driver without blocking
+#ifndef CM_USE_RX_TASK
+#define CM_USE_RX_TASK 1
+#endif
+#ifndef CM_RX_TASK_CORE
+#define CM_RX_TASK_CORE 0        // Arduino loop() runs on core 1
+#endif
+#ifndef CM_RX_TASK_PRIORITY
+#define CM_RX_TASK_PRIORITY 5
+#endif
+#ifndef CM_RX_TASK_WAIT_MS
+#define CM_RX_TASK_WAIT_MS 20    // Longest the task waits on the driver before checking for a pause
+#endif
+#ifndef CM_RX_TASK_STACK
+#define CM_RX_TASK_STACK 2048
+#endif
+
+#ifndef CM_RX_BATCH_BUDGET
+#define CM_RX_BATCH_BUDGET 32    // Max frames handled per handleCAN() call
+#endif
+
+// Result of one batch pass
+typedef struct {
+  uint16_t handled;  // frames dispatched in this call
+  uint16_t pending;  // frames still waiting when the call returned
+} CanBatchResult;
+
+// Dispatch table kinds, each 11-bit COB-ID maps to one kind and a channel (e.g. RPDO number)
+enum CanDispatchKind : uint8_t {
+  CAN_DISPATCH_NONE = 0,
+  CAN_DISPATCH_NMT,
+  CAN_DISPATCH_EMCY,
+  CAN_DISPATCH_RPDO,
+  CAN_DISPATCH_SDO_SERVER,
+  CAN_DISPATCH_SDO_CLIENT,
+  CAN_DISPATCH_HEARTBEAT,
+  CAN_DISPATCH_SYNC
+};
+
+// One dispatch entry per 11-bit COB-ID: kind in the top 4 bits, channel in the low 12 bits
+#define CAN_DISPATCH_SIZE 2048
+
+// Per node receive path, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  uint16_t canDispatch[CAN_DISPATCH_SIZE];
+  CanRxRing canRxRing;
+  TaskHandle_t canRxTaskHandle;
+  std::atomic<bool> rxPauseRequested;
+  std::atomic<bool> rxTaskPaused;
+} HandlerNodeState;
 
 void handleCAN(uint8_t nodeID, twai_message_t* pdoMsg = nullptr);
+CanBatchResult handleCANBatch(uint8_t nodeID, uint16_t budget = CM_RX_BATCH_BUDGET);
+
+// Receive path
+bool startCANRxTask();
+void pauseCANRxTask();
+void resumeCANRxTask();
+bool receiveCANFrame(twai_message_t* msg, uint32_t timeoutMs);
+uint16_t pendingCANFrames();
+uint32_t getCANRxDropped();
+
+// Dispatch table setup, filled in by initCANMREX(), configureRPDO() and setupHeartbeatConsumer()
+void resetCANDispatch();
+void setCANDispatch(uint16_t cobID, uint8_t kind, uint16_t channel = 0);
+void clearCANDispatch(uint16_t cobID);
+uint8_t getCANDispatchKind(uint16_t cobID);
 
 #endif
\ No newline at end of file
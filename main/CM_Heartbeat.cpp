@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    12/09/2025
- * Last Modified:   30/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  */
 
@@ -13,24 +13,58 @@
 #include "CM_Heartbeat.h"
 #include "CM_ObjectDictionary.h"
 #include "CM_EMCY.h"
+#include "CM_Handler.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
 
-nodeHeartbeat heartbeatTable[MAX_NODES];
-
-static uint32_t lastHeartbeatSendTime = 0;
 const uint32_t heartbeatTimeout = 1500;   // 1.5 seconds
 
+// Scheduler callback, sends the heartbeat and schedules the next one
+static void heartbeatTimerFired(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  twai_message_t txMsg;
+  txMsg.identifier = 0x700 + nodeID;
+  txMsg.data_length_code = 1;
+  txMsg.data[0] = cmOperatingMode();
+  txMsg.flags = TWAI_MSG_FLAG_NONE;
+
+  HeartbeatNodeState& hb = cmNode->heartbeat;
+  if (queueCANTx(txMsg, CAN_TX_HEARTBEAT)) {
+    hb.lastSendTime = now;
+    schedulerArm(hb.timer, now + cmHeartbeatInterval());
+  } else {
+    schedulerArm(hb.timer, now + 1);
+  }
+}
+
+// Scheduler callback for the consumer's once a second timeout check
+static void heartbeatCheckFired(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  checkHeartbeatTimeouts();
+  schedulerArm(cmNode->heartbeat.checkTimer, now + 1000);
+}
+
+void initHeartbeat() {
+  HeartbeatNodeState& hb = cmNode->heartbeat;
+  hb.lastSendTime = 0;
+  hb.lastCheckTime = 0;
+  hb.timer = schedulerCreateTimer(heartbeatTimerFired, 0);
+  hb.checkTimer = SCHED_INVALID_TIMER;
+  schedulerArm(hb.timer, millis());
+}
+
 // --- Producer Functions ---
 void sendHeartbeat(uint8_t nodeID) {
+  HeartbeatNodeState& hb = cmNode->heartbeat;
   uint32_t currentMs = millis();
-  if (currentMs - lastHeartbeatSendTime >= heartbeatInterval) {
+  if (currentMs - hb.lastSendTime >= cmHeartbeatInterval()) {
     twai_message_t txMsg;
     txMsg.identifier = 0x700 + nodeID;
     txMsg.data_length_code = 1;
-    txMsg.data[0] = nodeOperatingMode;
+    txMsg.data[0] = cmOperatingMode();
     txMsg.flags = TWAI_MSG_FLAG_NONE;
 
-    if (twai_transmit(&txMsg, pdMS_TO_TICKS(100)) == ESP_OK) {
-      lastHeartbeatSendTime = currentMs;
+    if (queueCANTx(txMsg, CAN_TX_HEARTBEAT)) {
+      hb.lastSendTime = currentMs;
     }
   }
 }
@@ -39,20 +73,20 @@ void sendHeartbeat(uint8_t nodeID) {
 void receiveHeartbeat(const twai_message_t& rxMsg) {
   uint8_t nodeIndex = rxMsg.identifier - 0x700;
   if (nodeIndex < MAX_NODES && rxMsg.data_length_code >= 1) {
-    heartbeatTable[nodeIndex].hbOperatingMode = rxMsg.data[0];
-    heartbeatTable[nodeIndex].lastHeartbeat = millis();
+    cmHeartbeatEntry(nodeIndex).hbOperatingMode = rxMsg.data[0];
+    cmHeartbeatEntry(nodeIndex).lastHeartbeat = millis();
   }
 }
 
 void checkHeartbeatTimeouts() {
-  static uint32_t lastCheckTime = 0;
+  HeartbeatNodeState& hb = cmNode->heartbeat;
   uint32_t currentMs = millis();
 
-  if (currentMs - lastCheckTime < 1000) return;  // Only run once per second
-  lastCheckTime = currentMs;
+  if (currentMs - hb.lastCheckTime < 1000) return;  // Only run once per second
+  hb.lastCheckTime = currentMs;
 
   for (uint8_t i = 0; i < MAX_NODES; i++) {
-    if (heartbeatTable[i].lastHeartbeat > 0 && currentMs - heartbeatTable[i].lastHeartbeat > heartbeatTimeout) {
+    if (cmHeartbeatEntry(i).lastHeartbeat > 0 && currentMs - cmHeartbeatEntry(i).lastHeartbeat > heartbeatTimeout) {
       sendEMCY(0x00, i, 0x00000101);
     }
   }
@@ -60,7 +94,11 @@ void checkHeartbeatTimeouts() {
 
 void setupHeartbeatConsumer() {
   for (uint8_t i = 0; i < MAX_NODES; i++) {
-    heartbeatTable[i].hbOperatingMode = 0x00;
-    heartbeatTable[i].lastHeartbeat = 0;
+    cmHeartbeatEntry(i).hbOperatingMode = 0x00;
+    cmHeartbeatEntry(i).lastHeartbeat = 0;
+    if (i > 0) setCANDispatch(0x700 + i, CAN_DISPATCH_HEARTBEAT, i);
   }
+  HeartbeatNodeState& hb = cmNode->heartbeat;
+  if (hb.checkTimer == SCHED_INVALID_TIMER) hb.checkTimer = schedulerCreateTimer(heartbeatCheckFired, 0);
+  schedulerArm(hb.checkTimer, millis() + 1000);
 }
@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    12/09/2025
- * Last Modified:   30/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  */
 
@@ -14,6 +14,7 @@
 
 #include <Arduino.h>
 #include "driver/twai.h"
+#include "CM_Scheduler.h"
 
 #define MAX_NODES 16  // Adjust based on your network size
 
@@ -22,8 +23,16 @@ typedef struct {
   uint32_t lastHeartbeat;
 } nodeHeartbeat;
 
-extern nodeHeartbeat heartbeatTable[MAX_NODES];
+// Per node producer/consumer state, owned by CanMrexNode (CM_Node.h). cmHeartbeatEntry() reads table of the active node
+typedef struct {
+  nodeHeartbeat table[MAX_NODES];
+  uint32_t lastSendTime;
+  uint32_t lastCheckTime;
+  SchedTimer timer;
+  SchedTimer checkTimer;   // SCHED_INVALID_TIMER until setupHeartbeatConsumer()
+} HeartbeatNodeState;
 
+void initHeartbeat();  // schedules the heartbeat producer, called from initCANMREX()
 void sendHeartbeat(uint8_t nodeID);
 void receiveHeartbeat(const twai_message_t& rxMsg);
 void checkHeartbeatTimeouts();
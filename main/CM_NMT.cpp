@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    12/09/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -15,10 +15,12 @@
 #include "CM_NMT.h"
 #include <Arduino.h>
 #include "CM_EMCY.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
 
 void handleNMT(const twai_message_t& rxMsg, uint8_t nodeID){
   if (rxMsg.data[1] != nodeID) return;
-  nodeOperatingMode = rxMsg.data[0];
+  cmOperatingMode() = rxMsg.data[0];
 }
 
 
@@ -26,9 +28,10 @@ void sendNMT(uint8_t sendOperatingMode, uint8_t targetNodeID){
   twai_message_t txMsg;
   txMsg.identifier = 0x000;
   txMsg.data_length_code = 2;
+  txMsg.flags = TWAI_MSG_FLAG_NONE;
   txMsg.data[0] = sendOperatingMode;
   txMsg.data[1] = targetNodeID;
-  if (twai_transmit(&txMsg, pdMS_TO_TICKS(100)) != ESP_OK) {
+  if (!queueCANTx(txMsg, CAN_TX_NMT)) {
     sendEMCY(0x00, targetNodeID, 0x00000201);
     return;
   }
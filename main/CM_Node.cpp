@@ -0,0 +1,24 @@
+/**
+ * CAN MREX Node context file
+ *
+ * File:            CM_Node.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "CM_Node.h"
+
+static CanMrexNode defaultNode;
+CanMrexNode* cmNode = &defaultNode;
+
+void cmSelectNode(CanMrexNode* node) {
+  cmNode = (node != nullptr) ? node : &defaultNode;
+}
+
+CanMrexNode* cmDefaultNode() {
+  return &defaultNode;
+}
@@ -0,0 +1,76 @@
+/**
+ * CAN MREX Node context file
+ *
+ * File:            CM_Node.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#ifndef CM_NODE_H
+#define CM_NODE_H
+
+#include <Arduino.h>
+#include "driver/twai.h"
+#include "CM_ObjectDictionary.h"
+#include "CM_PDO.h"
+#include "CM_SDO.h"
+#include "CM_Handler.h"
+#include "CM_Config.h"
+#include "CM_Heartbeat.h"
+#include "CM_SYNC.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+
+// Everything one CAN MREX node owns. The free functions (initCANMREX, handleCAN, mapTPDO, ...) act on the
+// active node, so a sketch with one node never sees this. Several nodes can share a process (e.g. the host
+// build simulating a whole train) by selecting each one before calling into it.
+// Create nodes as statics or with new CanMrexNode() so the state starts zeroed
+struct CanMrexNode {
+  uint8_t  nodeID = 0;                  // set by initCANMREX()
+  uint8_t  operatingMode = 0x02;        // OD 0x1000, stopped until NMT says otherwise
+  uint32_t heartbeatIntervalMs = 1000;  // OD 0x1017
+  uint8_t  minorEMCYCount = 0;
+
+  OdNodeState        od;
+  PdoNodeState       pdo;
+  SdoNodeState       sdo;
+  HandlerNodeState   handler;
+  ConfigNodeState    config;
+  HeartbeatNodeState heartbeat;
+  SyncNodeState      sync;
+  SchedulerNodeState sched;
+  TxQueueNodeState   tx;
+};
+
+// Active node, never null. Starts out pointing at a built-in default node
+extern CanMrexNode* cmNode;
+
+void cmSelectNode(CanMrexNode* node);  // nullptr selects the default node again
+CanMrexNode* cmDefaultNode();
+
+// The active node's OD 0x1000, OD 0x1017 and heartbeat consumer table
+inline uint8_t& cmOperatingMode() { return cmNode->operatingMode; }
+inline uint32_t& cmHeartbeatInterval() { return cmNode->heartbeatIntervalMs; }
+inline nodeHeartbeat& cmHeartbeatEntry(uint8_t index) { return cmNode->heartbeat.table[index]; }
+
+// Compatibility names for the old globals. Objects rather than macros, so the names stay free for locals and
+// members elsewhere, that read and assign the field of the active node
+template <typename T, T CanMrexNode::*Field>
+struct CmNodeField {
+  operator T&() const { return cmNode->*Field; }
+  T& operator=(T value) const { return cmNode->*Field = value; }
+};
+
+struct CmHeartbeatTable {
+  nodeHeartbeat& operator[](uint8_t index) const { return cmHeartbeatEntry(index); }
+};
+
+static const CmNodeField<uint8_t, &CanMrexNode::operatingMode> nodeOperatingMode = {};
+static const CmNodeField<uint32_t, &CanMrexNode::heartbeatIntervalMs> heartbeatInterval = {};
+static const CmHeartbeatTable heartbeatTable = {};
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * CAN MREX Compile-time Object Dictionary file
+ *
+ * File:            CM_ODTable.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * Declares a node's OD entries and PDO mappings as constants, so mistakes stop the build instead of showing
+ * up on the train. The table is sorted by the compiler and lives in flash, registerODTable() just points the
+ * node at it.
+ *
+ *   uint16_t speed;
+ *   uint8_t brake;
+ *
+ *   CM_OD_TABLE(motorOD,
+ *     CM_OD_ENTRY(0x60FF, 0x00, 2, speed),
+ *     CM_OD_ENTRY(0x3012, 0x01, 2, brake));
+ *
+ *   constexpr PdoMapEntry motorTpdo1[] = {{0x3012, 0x01, 8}};
+ *   CM_CHECK_TPDO_MAPPING(motorOD, motorTpdo1);
+ *
+ *   // in setup(), after initCANMREX()
+ *   registerODTable(motorOD);
+ *   mapTPDO(0, motorTpdo1, 1);
+ */
+
+#ifndef CM_OD_TABLE_H
+#define CM_OD_TABLE_H
+
+#include <stddef.h>
+#include <array>
+#include "CM_ObjectDictionary.h"
+#include "CM_PDO.h"
+
+// One entry, var must have static storage duration (a global or a static) so its address is a constant
+#define CM_OD_ENTRY(index, subindex, access, var) ODEntry{(index), (subindex), (access), sizeof(var), &(var)}
+
+// Sorted constant table called name, fails to compile if an index/subindex pair is used twice
+#define CM_OD_TABLE(name, ...)                                                                  \
+  constexpr ODEntry name##_unsorted[] = {__VA_ARGS__};                                        \
+  constexpr auto name = odSortTable(name##_unsorted);                                         \
+  static_assert(odTableUnique(name), "Object dictionary " #name " registers an index/subindex twice")
+
+// A TPDO mapping must only use entries that exist, with fields no bigger than the entry, 8 bytes at most
+#define CM_CHECK_TPDO_MAPPING(od, map)                                                          \
+  static_assert(pdoMappingExists(od, map), #map " maps an entry that is not in " #od);          \
+  static_assert(pdoMappingSizesMatch(od, map, false), #map " maps more bits than an entry has"); \
+  static_assert(pdoMappingBytes(map) <= 8, #map " is longer than 8 bytes");                    \
+  static_assert(sizeof(map) / sizeof(map[0]) <= CM_PDO_MAX_ENTRIES, #map " has more entries than CM_PDO_MAX_ENTRIES")
+
+// An RPDO mapping's whole byte fields must match the entry sizes exactly, since received bytes are written
+// straight into them
+#define CM_CHECK_RPDO_MAPPING(od, map)                                                          \
+  static_assert(pdoMappingExists(od, map), #map " maps an entry that is not in " #od);          \
+  static_assert(pdoMappingSizesMatch(od, map, true), #map " doesn't match the size of an entry"); \
+  static_assert(pdoMappingBytes(map) <= 8, #map " is longer than 8 bytes");                    \
+  static_assert(sizeof(map) / sizeof(map[0]) <= CM_PDO_MAX_ENTRIES, #map " has more entries than CM_PDO_MAX_ENTRIES")
+
+constexpr uint32_t odEntryKey(uint16_t index, uint8_t subindex) {
+  return ((uint32_t)index << 8) | subindex;
+}
+
+// Insertion sort, tables are small and this only ever runs in the compiler
+template <size_t N>
+constexpr std::array<ODEntry, N> odSortTable(const ODEntry (&entries)[N]) {
+  std::array<ODEntry, N> t{};
+  for (size_t i = 0; i < N; i++) {
+    ODEntry e = entries[i];
+    size_t j = i;
+    while (j > 0 && odEntryKey(t[j - 1].index, t[j - 1].subindex) > odEntryKey(e.index, e.subindex)) {
+      t[j] = t[j - 1];
+      j--;
+    }
+    t[j] = e;
+  }
+  return t;
+}
+
+template <size_t N>
+constexpr bool odTableUnique(const std::array<ODEntry, N>& t) {
+  for (size_t i = 1; i < N; i++) {
+    if (odEntryKey(t[i].index, t[i].subindex) == odEntryKey(t[i - 1].index, t[i - 1].subindex)) return false;
+  }
+  return true;
+}
+
+// Position of index/subindex in a sorted table, N if it isn't there
+template <size_t N>
+constexpr size_t odTableFind(const std::array<ODEntry, N>& t, uint16_t index, uint8_t subindex) {
+  size_t lo = 0, hi = N;
+  uint32_t key = odEntryKey(index, subindex);
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (odEntryKey(t[mid].index, t[mid].subindex) < key) lo = mid + 1;
+    else hi = mid;
+  }
+  return (lo < N && odEntryKey(t[lo].index, t[lo].subindex) == key) ? lo : N;
+}
+
+template <size_t N, size_t M>
+constexpr bool pdoMappingExists(const std::array<ODEntry, N>& t, const PdoMapEntry (&map)[M]) {
+  for (size_t i = 0; i < M; i++) {
+    if (odTableFind(t, map[i].index, map[i].subindex) == N) return false;
+  }
+  return true;
+}
+
+// Same rule as mapTPDO()/mapRPDO(): every field fits in its entry, an RX field of whole bytes is exactly the entry
+// size and an RX bit field's entry is at most 8 bytes
+template <size_t N, size_t M>
+constexpr bool pdoMappingSizesMatch(const std::array<ODEntry, N>& t, const PdoMapEntry (&map)[M], bool isRx) {
+  for (size_t i = 0; i < M; i++) {
+    size_t pos = odTableFind(t, map[i].index, map[i].subindex);
+    if (pos == N) continue; // reported by pdoMappingExists()
+    uint8_t bits = map[i].len_bits;
+    if (bits == 0 || bits > t[pos].size * 8) return false;
+    if (isRx && bits % 8 == 0 && t[pos].size != bits / 8) return false;
+    if (isRx && bits % 8 != 0 && t[pos].size > 8) return false;
+  }
+  return true;
+}
+
+template <size_t M>
+constexpr uint16_t pdoMappingBytes(const PdoMapEntry (&map)[M]) {
+  uint32_t bits = 0;
+  for (size_t i = 0; i < M; i++) bits += map[i].len_bits;
+  return (bits + 7) / 8;
+}
+
+template <size_t N>
+bool registerODTable(const std::array<ODEntry, N>& table) {
+  return registerODTable(table.data(), N);
+}
+
+#endif
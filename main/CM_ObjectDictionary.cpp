@@ -5,40 +5,139 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    6/08/2025
- * Last Modified:   12/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
 
 #include "CM_ObjectDictionary.h"
+#include "CM_Node.h"
+#include "CM_PDO.h"
+#include <string.h>
 
-uint8_t nodeOperatingMode = 0x02; // set operating mode to 0x02 initially
-uint32_t heartbeatInterval = 1000;
 
-#define MAX_OD_ENTRIES 32
-static ODEntry objectDictionary[MAX_OD_ENTRIES];
-static int odCount = 0;
+// Sort key for an entry, entries are kept in ascending key order so lookups can binary search
+static inline uint32_t odKey(uint16_t index, uint8_t subindex) {
+  return ((uint32_t)index << 8) | subindex;
+}
+
+// Returns the position of the first of count sorted entries whose key is >= key
+static int odLowerBound(const ODEntry* entries, int count, uint32_t key) {
+  int lo = 0;
+  int hi = count;
+  while (lo < hi) {
+    int mid = (lo + hi) >> 1;
+    if (odKey(entries[mid].index, entries[mid].subindex) < key) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static const ODEntry* odSearch(const ODEntry* entries, int count, uint32_t key) {
+  int pos = odLowerBound(entries, count, key);
+  if (pos < count && odKey(entries[pos].index, entries[pos].subindex) == key) return &entries[pos];
+  return nullptr;
+}
 
+// A node starts out on its built in storage, nothing to set up in CanMrexNode
+static void odUseBuiltIn(OdNodeState& od) {
+  if (od.entries != nullptr) return;
+  od.entries = od.builtIn;
+  od.capacity = MAX_OD_ENTRIES;
+}
+
+// od entry lookup (binary search over the constant table, then the runtime entries)
+const ODEntry* findODEntry(uint16_t index, uint8_t subindex) {
+  OdNodeState& od = cmNode->od;
+  uint32_t key = odKey(index, subindex);
+  const ODEntry* e = odSearch(od.table, od.tableCount, key);
+  if (e == nullptr) e = odSearch(od.entries, od.count, key);
+  od.stats.lookups++;
+  if (e == nullptr) od.stats.misses++;
+  return e;
+}
+
+// Inserts an entry in sorted position. Fails if the dictionary is full or the index/subindex is already registered
+bool registerODEntry(uint16_t index, uint8_t subindex, uint8_t access, uint16_t size, void* dataPtr) {
+  OdNodeState& od = cmNode->od;
+  odUseBuiltIn(od);
+  uint32_t key = odKey(index, subindex);
+  int pos = odLowerBound(od.entries, od.count, key);
+  if (odSearch(od.table, od.tableCount, key) != nullptr ||
+      (pos < od.count && odKey(od.entries[pos].index, od.entries[pos].subindex) == key)) {
+    od.stats.rejected++; // duplicate
+    return false;
+  }
+  if (od.count >= od.capacity) {
+    Serial.println("Error 0x00000602: OD full, give the node more entries with setODStorage()");
+    od.stats.rejected++;
+    return false;
+  }
+  memmove(&od.entries[pos + 1], &od.entries[pos], (od.count - pos) * sizeof(ODEntry));
+  od.entries[pos] = {index, subindex, access, size, dataPtr};
+  od.count++;
+  return true;
+}
 
-// od entry lookup
-ODEntry* findODEntry(uint16_t index, uint8_t subindex) {
-  for (int i = 0; i < odCount; i++) {
-    if (objectDictionary[i].index == index && objectDictionary[i].subindex == subindex) {
-      return &objectDictionary[i];
+bool registerODTable(const ODEntry* table, uint16_t count) {
+  OdNodeState& od = cmNode->od;
+  for (int i = 0; i < od.count; i++) {
+    if (odSearch(table, count, odKey(od.entries[i].index, od.entries[i].subindex)) != nullptr) {
+      Serial.println("Error 0x00000601: OD table overlaps registered entries");
+      return false;
     }
   }
-  return nullptr;
+  od.table = table;
+  od.tableCount = count;
+  return true;
 }
 
-bool registerODEntry(uint16_t index, uint8_t subindex, uint8_t access, uint8_t size, void* dataPtr) {
-  if (odCount >= MAX_OD_ENTRIES) return false;
-  objectDictionary[odCount++] = {index, subindex, access, size, dataPtr};
+bool writeODEntry(uint16_t index, uint8_t subindex, const void* value, uint16_t size) {
+  // PDO parameters are applied by the PDO module rather than stored
+  uint32_t current;
+  uint8_t objSize;
+  if (readPDOObject(index, subindex, &current, &objSize)) {
+    if (objSize != size) return false;
+    uint32_t v = 0;
+    memcpy(&v, value, size);
+    return writePDOObject(index, subindex, v);
+  }
+  const ODEntry* e = findODEntry(index, subindex);
+  if (e == nullptr || e->size != size) return false;
+  if (memcmp(e->dataPtr, value, size) != 0) {
+    memcpy(e->dataPtr, value, size);
+    markTpdosMapping(e->dataPtr);
+  }
   return true;
 }
 
+void odValueChanged(const void* dataPtr) {
+  markTpdosMapping(dataPtr);
+}
+
+bool setODStorage(ODEntry* storage, uint16_t capacity) {
+  OdNodeState& od = cmNode->od;
+  odUseBuiltIn(od);
+  if (storage == nullptr || capacity < od.count) return false;
+  if (storage != od.entries) memcpy(storage, od.entries, od.count * sizeof(ODEntry));
+  od.entries = storage;
+  od.capacity = capacity;
+  return true;
+}
+
+OdStats getODStats() {
+  OdNodeState& od = cmNode->od;
+  odUseBuiltIn(od);
+  OdStats s = od.stats;
+  s.capacity = od.capacity;
+  s.used = od.count;
+  s.tableEntries = od.tableCount;
+  return s;
+}
+
 void initDefaultOD(){
-  registerODEntry(0x1000, 0x00, 2, sizeof(uint8_t), &nodeOperatingMode); 
-  registerODEntry(0x1017, 0x00, 0, sizeof(uint32_t), &heartbeatInterval);
+  registerODEntry(0x1000, 0x00, 2, sizeof(uint8_t), &cmOperatingMode()); 
+  registerODEntry(0x1017, 0x00, 0, sizeof(uint32_t), &cmHeartbeatInterval());
 }
 
 
@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    6/08/2025
- * Last Modified:   12/09/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -16,22 +16,105 @@
 #define CM_OBJECT_DICTIONARY_H
 
 #include <stdint.h>
+#include <string.h>
 
-extern uint8_t nodeOperatingMode;  // set operating mode to 0x02 initially
-extern uint32_t heartbeatInterval;
+// Entries every node can hold without extra storage. Nodes that need more give the stack a bigger array with
+// setODStorage() instead of raising this for every node
+#ifndef MAX_OD_ENTRIES
+#define MAX_OD_ENTRIES 32
+#endif
 
 typedef struct {
   uint16_t index;
   uint8_t subindex;
   uint8_t access; // 0 = RO, 1 = WO, 2 = RW
-  uint8_t size;   // in bytes
+  uint16_t size;  // in bytes, over 4 is read and written with segmented SDO transfers
   void* dataPtr;
 } ODEntry;
 
-ODEntry* findODEntry(uint16_t index, uint8_t subindex);
+typedef struct {
+  uint16_t capacity;      // runtime entries the current storage can hold
+  uint16_t used;          // runtime entries registered
+  uint16_t tableEntries;  // entries in the constant table from registerODTable()
+  uint32_t lookups;       // findODEntry() calls
+  uint32_t misses;        // lookups that found nothing
+  uint32_t rejected;      // registerODEntry() calls refused because the storage was full or the entry existed
+} OdStats;
+
+// Per node dictionary, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  ODEntry builtIn[MAX_OD_ENTRIES];
+  ODEntry* entries;                  // registered at runtime, builtIn unless setODStorage() was called
+  uint16_t capacity;
+  int count;
+  const ODEntry* table;              // sorted constant table from registerODTable(), see CM_ODTable.h
+  uint16_t tableCount;
+  OdStats stats;
+} OdNodeState;
+
+// Entries are stored sorted by (index << 8 | subindex), lookups are O(log n)
+const ODEntry* findODEntry(uint16_t index, uint8_t subindex);
+
+// Returns false if the dictionary is full or the index/subindex pair is already registered
+bool registerODEntry(uint16_t index, uint8_t subindex, uint8_t access, uint16_t size, void* dataPtr);
+
+// Points the active node at a sorted constant table (build it with CM_OD_TABLE). Entries registered at runtime,
+// including the defaults from initDefaultOD(), are kept alongside it. Returns false if the two overlap
+bool registerODTable(const ODEntry* table, uint16_t count);
+
+// Moves the active node's runtime entries into storage, a static array the caller keeps for the life of the
+// node (no heap, nothing is ever freed). Works before or after initCANMREX(). Returns false if storage can't
+// hold the entries already registered
+bool setODStorage(ODEntry* storage, uint16_t capacity);
 
-bool registerODEntry(uint16_t index, uint8_t subindex, uint8_t access, uint8_t size, void* dataPtr);
+template <uint16_t N>
+bool setODStorage(ODEntry (&storage)[N]) {
+  return setODStorage(storage, N);
+}
+
+OdStats getODStats();
+
+// Writes size bytes into an entry and, if the value changed, marks the TPDOs that map it dirty so they go out
+// straight away (still subject to their inhibit time). Returns false if the entry doesn't exist or size is wrong.
+// PDO communication/mapping objects (0x1400-0x1BFF) are written through writePDOObject() instead
+bool writeODEntry(uint16_t index, uint8_t subindex, const void* value, uint16_t size);
+
+template <typename T>
+bool writeODEntry(uint16_t index, uint8_t subindex, const T& value) {
+  return writeODEntry(index, subindex, &value, sizeof(T));
+}
+
+// Tells the stack the OD variable at dataPtr was changed by user code, for writes that don't go through
+// writeODEntry()
+void odValueChanged(const void* dataPtr);
+
+// A variable that marks its TPDOs dirty whenever it is assigned a new value. Register it like the plain type,
+// it has the same size and layout:
+//
+//   CmWatched<uint8_t> directionMode;
+//   registerODEntry(0x6060, 0x00, 2, sizeof(directionMode), &directionMode);
+//   directionMode = readSwitch();   // TPDO sent now instead of at the next event timer
+template <typename T>
+class CmWatched {
+public:
+  constexpr CmWatched(T v = T()) : value(v) {}
+  CmWatched& operator=(T v) {
+    if (memcmp(&value, &v, sizeof(T)) != 0) {
+      value = v;
+      odValueChanged(&value);
+    }
+    return *this;
+  }
+  operator T() const { return value; }
+
+private:
+  T value;
+};
 
 void initDefaultOD();
 
+// nodeOperatingMode and heartbeatInterval live in the active CanMrexNode. Included last, CanMrexNode needs the
+// types above
+#include "CM_Node.h"
+
 #endif
\ No newline at end of file
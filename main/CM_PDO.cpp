@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    18/08/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -14,16 +14,14 @@
 #include "CM_ObjectDictionary.h"  // for findODEntry
 #include <string.h>
 #include "CM_EMCY.h"
+#include "CM_Handler.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
+#include "CM_SDO.h"  // abort codes for writePDOObject()
 
-// Initialise all structs and variables
-static PdoComm rpdoComm[4];
-static PdoMap  rpdoMap[4];
-
-static PdoComm tpdoComm[4];
-static PdoMap  tpdoMap[4];
-
-static TpdoState tpdoState[4];
-static bool tpdoDirty[4];
+static void tpdoTimerFired(uint8_t nodeID, uint16_t pdoNum, uint32_t now);
+static void rpdoTimerFired(uint8_t nodeID, uint16_t pdoNum, uint32_t now);
 
 // Sets communication parameters for a PDO (COB-ID, transmission type, timers, enable flag)
 static void setComm(PdoComm& c, uint32_t cob, uint8_t ttype, uint16_t inhibit_ms, uint16_t evt_ms) {
@@ -34,172 +32,695 @@ static void setComm(PdoComm& c, uint32_t cob, uint8_t ttype, uint16_t inhibit_ms
   c.enabled = ((cob & 0x80000000u) == 0);
 }
 
+// Transmission types 0..240 are driven by SYNC instead of timers
+static inline bool isSyncPDO(const PdoComm& c) {
+  return c.trans_type <= 240;
+}
+
 // Initializes all TPDOs and RPDOs as disabled and clears runtime state
 void initDefaultPDOs(uint8_t nodeID) {
-  for (int i = 0; i < 4; i++) {
-    setComm(tpdoComm[i], 0x80000000u | (0x180 + (i * 0x100) + nodeID), 255, 0, 0); // disabled by bit31
-    setComm(rpdoComm[i], 0x80000000u | (0x200 + (i * 0x100) + nodeID), 255, 0, 0);
+  PdoNodeState& pdo = cmNode->pdo;
+  // Predefined connection set COB-IDs for the first four, the rest have no default and must be configured
+  for (int i = 0; i < CM_MAX_TPDOS; i++) {
+    uint32_t cob = i < 4 ? 0x180 + (i * 0x100) + nodeID : 0;
+    setComm(pdo.tpdoComm[i], 0x80000000u | cob, 255, 0, 0); // disabled by bit31
+  }
+  for (int i = 0; i < CM_MAX_RPDOS; i++) {
+    uint32_t cob = i < 4 ? 0x200 + (i * 0x100) + nodeID : 0;
+    setComm(pdo.rpdoComm[i], 0x80000000u | cob, 255, 0, 0);
   }
 
-  memset(tpdoState, 0, sizeof(tpdoState));
-  memset(tpdoDirty, 0, sizeof(tpdoDirty));
+  memset(pdo.tpdoPlan, 0, sizeof(pdo.tpdoPlan));
+  memset(pdo.rpdoPlan, 0, sizeof(pdo.rpdoPlan));
+  memset(pdo.tpdoState, 0, sizeof(pdo.tpdoState));
+  memset(pdo.rpdoLatched, 0, sizeof(pdo.rpdoLatched));
+  memset(pdo.tpdoDirty, 0, sizeof(pdo.tpdoDirty));
+  memset(pdo.tpdoSendMode, TPDO_SEND_SAMPLED, sizeof(pdo.tpdoSendMode));
+  pdo.tpdoSourceCount = 0;
+
+  // One scheduler timer per TPDO, armed for the next event timer/inhibit deadline or dirty mark
+  for (int i = 0; i < CM_MAX_TPDOS; i++) pdo.tpdoTimer[i] = schedulerCreateTimer(tpdoTimerFired, i);
+
+  // RPDO deadlines, only armed once setRPDOTimeout() is called
+  memset(pdo.rpdoMonitor, 0, sizeof(pdo.rpdoMonitor));
+  for (int i = 0; i < CM_MAX_RPDOS; i++) pdo.rpdoMonitor[i].timer = schedulerCreateTimer(rpdoTimerFired, i);
+
+  memset(pdo.rpdoBuffered, 0, sizeof(pdo.rpdoBuffered));
+  memset(pdo.rpdoSnapshotTaken, 0, sizeof(pdo.rpdoSnapshotTaken));
+  for (int i = 0; i < CM_MAX_RPDOS; i++) {
+    seqlockReset(pdo.rpdoSnapshot[i]);
+    pdo.rpdoPlanSeq[i].store(0, std::memory_order_relaxed);
+  }
+  pdo.tpdoWasOperational = false;
+  pdo.stagedMapIndex = 0;
 }
 
-// Reads a mapped variable from the object dictionary and packs it into a TPDO payload
-static bool readMapped(const PdoMapEntry& me, uint8_t* out, uint8_t& offsetBytes) {
-  ODEntry* od = findODEntry(me.index, me.subindex);
-  if (!od || (me.len_bits % 8) != 0) return false;
-  uint8_t n = me.len_bits / 8;
-  if (offsetBytes + n > 8) return false; // classic CAN
-  // CANopen uses little-endian for basic types in mapping
-  memcpy(out + offsetBytes, od->dataPtr, n);
-  offsetBytes += n;
+// Resolves mapping entries against the object dictionary into a copy plan. A field of whole bytes must be no
+// bigger than its entry (isRx: exactly its size, the received bytes are written into the OD variable). A bit field
+// must fit in its entry and is zero-extended to the entry's size when received
+static bool buildPlan(const PdoMapEntry* entries, uint8_t count, bool isRx, PdoPlan& plan) {
+  uint8_t bit = 0;
+  plan.bitPacked = false;
+  for (uint8_t i = 0; i < count; i++) {
+    const ODEntry* od = findODEntry(entries[i].index, entries[i].subindex);
+    uint8_t bits = entries[i].len_bits;
+    if (!od || bits == 0 || bits > od->size * 8) return false;
+    if (bit + bits > 64) return false; // classic CAN
+    uint8_t n = (bits + 7) / 8;
+    if (bits % 8 == 0) {
+      if (isRx && od->size != n) return false;
+      if (bit % 8 != 0) plan.bitPacked = true;
+    } else {
+      plan.bitPacked = true;
+      if (isRx && od->size > 8) return false; // zero-extended into the whole variable
+      if (isRx) n = od->size;
+    }
+    uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+    plan.e[i] = {od->dataPtr, (uint8_t)(bit / 8), n, bit, false, mask};
+    bit += bits;
+  }
+  plan.count = count;
+  plan.totalLen = (bit + 7) / 8;
   return true;
 }
 
-// Writes a received RPDO value into the corresponding object dictionary entry
-static bool writeMapped(const PdoMapEntry& me, const uint8_t* in, uint8_t& offsetBytes) {
-  ODEntry* od = findODEntry(me.index, me.subindex);
-  if (!od || (me.len_bits % 8) != 0) return false;
-  uint8_t n = me.len_bits / 8;
-  if (offsetBytes + n > 8) return false;
-  // Basic safety: size must match
-  if (od->size != n) return false;
-  memcpy(od->dataPtr, in + offsetBytes, n);
-  offsetBytes += n;
-  return true;
+// Fixed size copies for the usual variable sizes so the compiler turns them into single loads/stores
+static inline uint64_t loadField(const void* ptr, uint8_t len) {
+  switch (len) {
+    case 1: return *(const uint8_t*)ptr;
+    case 2: { uint16_t v; memcpy(&v, ptr, 2); return v; }
+    case 4: { uint32_t v; memcpy(&v, ptr, 4); return v; }
+    case 8: { uint64_t v; memcpy(&v, ptr, 8); return v; }
+    default: { uint64_t v = 0; memcpy(&v, ptr, len); return v; }
+  }
+}
+
+static inline void storeField(void* ptr, uint64_t v, uint8_t len) {
+  switch (len) {
+    case 1: *(uint8_t*)ptr = (uint8_t)v; break;
+    case 2: { uint16_t w = (uint16_t)v; memcpy(ptr, &w, 2); break; }
+    case 4: { uint32_t w = (uint32_t)v; memcpy(ptr, &w, 4); break; }
+    case 8: memcpy(ptr, &v, 8); break;
+    default: memcpy(ptr, &v, len); break;
+  }
+}
+
+// Bit-packed plans build the payload as one 64-bit word. CANopen payloads and the ESP32/x86 hosts are both
+// little-endian, so byte i of the word is byte i of the frame
+static uint64_t packBits(const PdoPlan& p) {
+  uint64_t word = 0;
+  for (uint8_t i = 0; i < p.count; i++) word |= (loadField(p.e[i].dataPtr, p.e[i].len) & p.e[i].mask) << p.e[i].shift;
+  return word;
+}
+
+// Copies the plan's variables into a payload, totalLen bytes
+static void packPlan(const PdoPlan& p, uint8_t* outBytes) {
+  // CANopen uses little-endian for basic types in mapping
+  if (p.bitPacked) {
+    uint64_t word = packBits(p);
+    memcpy(outBytes, &word, p.totalLen);
+  } else {
+    for (uint8_t i = 0; i < p.count; i++) memcpy(outBytes + p.e[i].offset, p.e[i].dataPtr, p.e[i].len);
+  }
 }
 
 // Packs all mapped entries of a TPDO into a CAN payload buffer
-bool packTPDO(uint8_t nodeID, uint8_t pdoNum, uint8_t* outBytes, uint8_t* outLen) {
-  if (pdoNum >= 4) return false;
-  if (!tpdoComm[pdoNum].enabled) return false;
-  uint8_t off = 0;
-  for (uint8_t i = 0; i < tpdoMap[pdoNum].count; i++) {
-    if (!readMapped(tpdoMap[pdoNum].e[i], outBytes, off)) {
-      sendEMCY(0x01, nodeID, 0x00000401); // TPDO read mapping failed
-      return false;
+bool packTPDO(uint8_t nodeID, uint16_t pdoNum, uint8_t* outBytes, uint8_t* outLen) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_TPDOS) return false;
+  if (!pdo.tpdoComm[pdoNum].enabled || pdo.tpdoPlan[pdoNum].count == 0) return false;
+  packPlan(pdo.tpdoPlan[pdoNum], outBytes);
+  *outLen = pdo.tpdoPlan[pdoNum].totalLen;
+  return true;
+}
+
+// Writes a payload of totalLen bytes into the plan's variables. Only copies, so it can run outside handleCAN()
+static void unpackPlan(const PdoPlan& p, const uint8_t* data) {
+  if (p.bitPacked) {
+    uint64_t word = 0;
+    memcpy(&word, data, p.totalLen);
+    for (uint8_t i = 0; i < p.count; i++) {
+      storeField(p.e[i].dataPtr, (word >> p.e[i].shift) & p.e[i].mask, p.e[i].len);
     }
+    return;
   }
-  *outLen = off;
-  return true;
+  for (uint8_t i = 0; i < p.count; i++) memcpy(p.e[i].dataPtr, data + p.e[i].offset, p.e[i].len);
+}
+
+// Marks the TPDOs that the plan's values are passed straight through to
+static void markPlanTpdos(const PdoPlan& p) {
+  for (uint8_t i = 0; i < p.count; i++) {
+    if (p.e[i].feedsTpdo) markTpdosMapping(p.e[i].dataPtr);
+  }
+}
+
+// rpdoPlan[pdoNum] may be read by takeRPDOSnapshot() in another task, every rewrite goes between these two
+static void beginRpdoPlanWrite(PdoNodeState& pdo, uint16_t pdoNum) {
+  pdo.rpdoPlanSeq[pdoNum].fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void endRpdoPlanWrite(PdoNodeState& pdo, uint16_t pdoNum) {
+  pdo.rpdoPlanSeq[pdoNum].fetch_add(1, std::memory_order_release);
 }
 
 // Unpacks an RPDO payload and writes its values into mapped object dictionary entries
-bool unpackRPDO(uint8_t nodeID, uint8_t pdoNum, const uint8_t* data, uint8_t len) {
-  if (pdoNum >= 4) return false;
-  if (!rpdoComm[pdoNum].enabled) return false;
-  // Quick length check: sum of bytes must match DLC
-  uint8_t needed = 0;
-  for (uint8_t i = 0; i < rpdoMap[pdoNum].count; i++) needed += rpdoMap[pdoNum].e[i].len_bits / 8;
-  if (needed != len) return false;
-  uint8_t off = 0;
-  for (uint8_t i = 0; i < rpdoMap[pdoNum].count; i++) {
-    if (!writeMapped(rpdoMap[pdoNum].e[i], data, off)) {
-      sendEMCY(0x01, nodeID, 0x00000402); // RPDO write mapping failed
-      return false;
-    }
+bool unpackRPDO(uint8_t nodeID, uint16_t pdoNum, const uint8_t* data, uint8_t len) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS) return false;
+  if (!pdo.rpdoComm[pdoNum].enabled) return false;
+  const PdoPlan& p = pdo.rpdoPlan[pdoNum];
+  if (p.totalLen != len) return false; // sum of mapped bytes must match DLC
+  if (pdo.rpdoBuffered[pdoNum]) {
+    seqlockWrite(pdo.rpdoSnapshot[pdoNum], data, len, pdo.rpdoPlanSeq[pdoNum].load(std::memory_order_relaxed));
+  } else {
+    unpackPlan(p, data);
   }
+  markPlanTpdos(p); // here rather than in takeRPDOSnapshot(), TPDO state belongs to the task running handleCAN()
   return true;
 }
 
-// Processes an incoming RPDO message by matching its COB-ID and unpacking its data
-void processRPDO(const twai_message_t& rx, uint8_t nodeID) {
-  for (uint8_t i = 0; i < 4; i++) {
-    if (rpdoComm[i].enabled && rx.identifier == (rpdoComm[i].cob_id & 0x7FF)) {
-      if (!unpackRPDO(nodeID, i, rx.data, rx.data_length_code)) {
-        sendEMCY(0x01, nodeID, 0x00000404); // RPDO unpack failed
+// Sort key of a source, by address then TPDO
+static inline bool sourceBefore(const TpdoSource& a, uintptr_t ptr, uint16_t pdoNum) {
+  return a.dataPtr < ptr || (a.dataPtr == ptr && a.pdoNum < pdoNum);
+}
+
+// Position of the first source that doesn't sort before (ptr, pdoNum)
+static uint16_t tpdoSourceLowerBound(const PdoNodeState& pdo, uintptr_t ptr, uint16_t pdoNum) {
+  uint16_t lo = 0;
+  uint16_t hi = pdo.tpdoSourceCount;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) >> 1;
+    if (sourceBefore(pdo.tpdoSources[mid], ptr, pdoNum)) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// Marks the entries of an RPDO plan whose variable a TPDO maps, so unpacking only looks up those
+static void flagTpdoSources(PdoPlan& plan) {
+  PdoNodeState& pdo = cmNode->pdo;
+  for (uint8_t i = 0; i < plan.count; i++) {
+    uintptr_t ptr = (uintptr_t)plan.e[i].dataPtr;
+    uint16_t pos = tpdoSourceLowerBound(pdo, ptr, 0);
+    plan.e[i].feedsTpdo = pos < pdo.tpdoSourceCount && pdo.tpdoSources[pos].dataPtr == ptr;
+  }
+}
+
+// Rebuilds the address -> TPDO index from the TPDO plans
+static void rebuildTpdoSources() {
+  PdoNodeState& pdo = cmNode->pdo;
+  pdo.tpdoSourceCount = 0;
+  for (uint16_t n = 0; n < CM_MAX_TPDOS; n++) {
+    const PdoPlan& p = pdo.tpdoPlan[n];
+    for (uint8_t i = 0; i < p.count; i++) {
+      uintptr_t ptr = (uintptr_t)p.e[i].dataPtr;
+      uint16_t pos = tpdoSourceLowerBound(pdo, ptr, n);
+      if (pos < pdo.tpdoSourceCount && pdo.tpdoSources[pos].dataPtr == ptr && pdo.tpdoSources[pos].pdoNum == n) {
+        continue; // mapped twice into the same TPDO
       }
+      memmove(&pdo.tpdoSources[pos + 1], &pdo.tpdoSources[pos], (pdo.tpdoSourceCount - pos) * sizeof(TpdoSource));
+      pdo.tpdoSources[pos] = {ptr, n};
+      pdo.tpdoSourceCount++;
+    }
+  }
+  for (uint16_t n = 0; n < CM_MAX_RPDOS; n++) {
+    beginRpdoPlanWrite(pdo, n);
+    flagTpdoSources(pdo.rpdoPlan[n]);
+    endRpdoPlanWrite(pdo, n);
+  }
+}
+
+void markTpdosMapping(const void* dataPtr) {
+  PdoNodeState& pdo = cmNode->pdo;
+  uintptr_t ptr = (uintptr_t)dataPtr;
+  for (uint16_t pos = tpdoSourceLowerBound(pdo, ptr, 0); pos < pdo.tpdoSourceCount; pos++) {
+    if (pdo.tpdoSources[pos].dataPtr != ptr) break;
+    markTpdoDirty(pdo.tpdoSources[pos].pdoNum);
+  }
+}
+
+// Restarts an RPDO's deadline from now, called for every valid frame
+static void rpdoReceived(uint16_t pdoNum, uint32_t now) {
+  RpdoMonitor& m = cmNode->pdo.rpdoMonitor[pdoNum];
+  m.last_rx_ms = now;
+  m.received = true;
+  m.expired = false;
+  if (m.timeout_ms > 0) schedulerArm(m.timer, now + m.timeout_ms);
+}
+
+// Processes an incoming RPDO message, the channel has already been matched by the dispatch table.
+// Synchronous RPDOs are held until the next SYNC, the latest frame wins
+void processRPDO(const twai_message_t& rx, uint8_t nodeID, uint16_t pdoNum) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS) return;
+  if (isSyncPDO(pdo.rpdoComm[pdoNum])) {
+    if (rx.data_length_code != pdo.rpdoPlan[pdoNum].totalLen) {
+      sendEMCY(0x01, nodeID, 0x00000404); // RPDO unpack failed
       return;
     }
+    memcpy(pdo.rpdoLatch[pdoNum], rx.data, rx.data_length_code);
+    pdo.rpdoLatchLen[pdoNum] = rx.data_length_code;
+    pdo.rpdoLatched[pdoNum] = true;
+    rpdoReceived(pdoNum, millis());
+    return;
+  }
+  if (!unpackRPDO(nodeID, pdoNum, rx.data, rx.data_length_code)) {
+    sendEMCY(0x01, nodeID, 0x00000404); // RPDO unpack failed
+    return;
+  }
+  rpdoReceived(pdoNum, millis());
+}
+
+// Scheduler callback for an RPDO deadline. Not re-armed here, the next valid frame or entering operational does that
+static void rpdoTimerFired(uint8_t nodeID, uint16_t pdoNum, uint32_t now) {
+  PdoNodeState& pdo = cmNode->pdo;
+  RpdoMonitor& m = pdo.rpdoMonitor[pdoNum];
+  if (!pdo.rpdoComm[pdoNum].enabled || m.timeout_ms == 0 || cmOperatingMode() != 0x01) return;
+  m.expired = true;
+  pdo.rpdoLatched[pdoNum] = false; // a stale synchronous frame must not overwrite the safe defaults
+  if (m.has_safe) unpackRPDO(nodeID, pdoNum, m.safe_payload, pdo.rpdoPlan[pdoNum].totalLen);
+  sendEMCY(0x01, nodeID, 0x00000405); // RPDO deadline missed
+  if (m.callback != nullptr) m.callback(nodeID, pdoNum);
+}
+
+// Arms a TPDO for its next deadline counted from `from`, depending on its send mode
+static void armTPDO(uint16_t pdoNum, uint32_t from) {
+  PdoNodeState& pdo = cmNode->pdo;
+  const PdoComm& c = pdo.tpdoComm[pdoNum];
+  const TpdoState& st = pdo.tpdoState[pdoNum];
+  uint8_t mode = pdo.tpdoSendMode[pdoNum];
+  if (isSyncPDO(c)) schedulerDisarm(pdo.tpdoTimer[pdoNum]); // sent from processSyncPDOs()
+  else if (mode == TPDO_SEND_SAMPLED) {
+    // Sampled every millisecond (every handleCAN() on a slower loop) once event_timer has passed since the last send
+    uint32_t at = from + 1;
+    if (st.last_valid && (int32_t)(st.last_tx_ms + c.event_timer - at) > 0) at = st.last_tx_ms + c.event_timer;
+    schedulerArm(pdo.tpdoTimer[pdoNum], at);
+  }
+  else if (pdo.tpdoDirty[pdoNum]) schedulerArm(pdo.tpdoTimer[pdoNum], from + 1); // retry an event-driven send that failed
+  else if (mode == TPDO_SEND_ON_CHANGE_PERIODIC && c.event_timer > 0) {
+    schedulerArm(pdo.tpdoTimer[pdoNum], (st.last_valid ? st.last_tx_ms : from) + c.event_timer);
+  }
+  else schedulerDisarm(pdo.tpdoTimer[pdoNum]);
+}
+
+// Compares the mapped OD variables straight against the last payload sent, field by field, stopping at the
+// first difference. Nothing is packed unless something changed
+static bool tpdoChanged(uint16_t pdoNum) {
+  PdoNodeState& pdo = cmNode->pdo;
+  const PdoPlan& p = pdo.tpdoPlan[pdoNum];
+  const TpdoState& st = pdo.tpdoState[pdoNum];
+  if (!st.last_valid || st.last_len != p.totalLen) return true;
+  if (p.bitPacked) {
+    uint64_t last = 0;
+    memcpy(&last, st.last_payload, st.last_len);
+    return packBits(p) != last;
   }
+  for (uint8_t i = 0; i < p.count; i++) {
+    if (memcmp(st.last_payload + p.e[i].offset, p.e[i].dataPtr, p.e[i].len) != 0) return true;
+  }
+  return false;
 }
 
 // Marks a TPDO as dirty, triggering event-driven transmission on next service cycle
-void markTpdoDirty(uint8_t pdoNum) {
-  if (pdoNum < 4) tpdoDirty[pdoNum] = true;
+void markTpdoDirty(uint16_t pdoNum) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_TPDOS) return;
+  pdo.tpdoDirty[pdoNum] = true;
+  if (pdo.tpdoComm[pdoNum].enabled && !isSyncPDO(pdo.tpdoComm[pdoNum])) {
+    schedulerArm(pdo.tpdoTimer[pdoNum], millis()); // inhibit time is checked when it fires
+  }
 }
 
-// Services all TPDOs: checks timers, dirty flags, inhibits, and transmits if due
-void serviceTPDOs(uint8_t nodeID) {
-  uint32_t now = millis();
+// Packs a TPDO straight into a frame and queues it, the payload is kept to detect changes
+static void sendTPDO(uint8_t nodeID, uint16_t i, uint32_t now) {
+  PdoNodeState& pdo = cmNode->pdo;
+  twai_message_t tx{};
+  uint8_t len = 0;
+  if (!packTPDO(nodeID, i, tx.data, &len)) return;
+  tx.identifier = pdo.tpdoComm[i].cob_id & 0x7FF;
+  tx.data_length_code = len;
+  tx.flags = TWAI_MSG_FLAG_NONE;
 
-  for (uint8_t i = 0; i < 4; i++) {
-    if (!tpdoComm[i].enabled) continue;
+  if (queueCANTx(tx, CAN_TX_PDO)) {
+    pdo.tpdoState[i].last_tx_ms = now;
+    pdo.tpdoState[i].last_len = len;
+    memcpy(pdo.tpdoState[i].last_payload, tx.data, len);
+    pdo.tpdoState[i].last_valid = true;
+    pdo.tpdoDirty[i] = false;
+  } else {
+    sendEMCY(0x01, nodeID, 0x00000403); // TPDO transmission failed
+  }
+}
 
-    bool due = false;
+// Scheduler callback for one TPDO: checks inhibit time, packs and transmits if the payload changed
+static void tpdoTimerFired(uint8_t nodeID, uint16_t i, uint32_t now) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (!pdo.tpdoComm[i].enabled || cmOperatingMode() != 0x01) return; // serviceTPDOs() re-arms it once operational
+  if (isSyncPDO(pdo.tpdoComm[i])) return;
 
-    // Event timer
-    if (tpdoComm[i].event_timer > 0) {
-      if (now - tpdoState[i].last_tx_ms >= tpdoComm[i].event_timer) due = true;
-    }
+  // Inhibit time check
+  if (pdo.tpdoComm[i].inhibit_time > 0 && now - pdo.tpdoState[i].last_tx_ms < pdo.tpdoComm[i].inhibit_time) {
+    schedulerArm(pdo.tpdoTimer[i], pdo.tpdoState[i].last_tx_ms + pdo.tpdoComm[i].inhibit_time);
+    return;
+  }
 
-    // Event-driven (dirty flag)
-    if (tpdoDirty[i]) due = true;
+  // Only sampled TPDOs look at their values without a write marking them dirty. A periodic send is due
+  // whether or not anything changed
+  const TpdoState& st = pdo.tpdoState[i];
+  uint8_t mode = pdo.tpdoSendMode[i];
+  bool periodDue = mode == TPDO_SEND_ON_CHANGE_PERIODIC && pdo.tpdoComm[i].event_timer > 0 &&
+                   (!st.last_valid || now - st.last_tx_ms >= pdo.tpdoComm[i].event_timer);
+  bool check = mode == TPDO_SEND_SAMPLED || pdo.tpdoDirty[i] || !st.last_valid;
+  if (!periodDue && !(check && tpdoChanged(i))) {
+    pdo.tpdoDirty[i] = false;
+    armTPDO(i, now);
+    return;
+  }
 
-    if (!due) continue;
+  sendTPDO(nodeID, i, now);
+  armTPDO(i, now);
+}
 
-    // Inhibit time check
-    if (tpdoComm[i].inhibit_time > 0) {
-      if (now - tpdoState[i].last_tx_ms < tpdoComm[i].inhibit_time) continue;
+// TPDOs are sent from the scheduler. This only re-arms them when the node enters operational mode,
+// since their timers are dropped while it isn't
+void serviceTPDOs(uint8_t nodeID) {
+  PdoNodeState& pdo = cmNode->pdo;
+  bool operational = cmOperatingMode() == 0x01;
+  if (operational && !pdo.tpdoWasOperational) {
+    uint32_t now = millis();
+    for (uint16_t i = 0; i < CM_MAX_TPDOS; i++) {
+      if (pdo.tpdoComm[i].enabled) schedulerArm(pdo.tpdoTimer[i], now);
     }
+    // A producer gets a full deadline to start sending after this node becomes operational
+    for (uint16_t i = 0; i < CM_MAX_RPDOS; i++) {
+      RpdoMonitor& m = pdo.rpdoMonitor[i];
+      m.received = false;
+      m.expired = false;
+      if (m.timeout_ms > 0) schedulerArm(m.timer, now + m.timeout_ms);
+    }
+  }
+  pdo.tpdoWasOperational = operational;
+}
 
-    uint8_t payload[8] = {0};
-    uint8_t len = 0;
-    if (!packTPDO(nodeID, i, payload, &len)) continue;
-
-    // Suppress unchanged payload (optional)
-    if (tpdoState[i].last_valid && tpdoState[i].last_len == len &&
-        memcmp(tpdoState[i].last_payload, payload, len) == 0) {
-      tpdoDirty[i] = false;
+// Called on every SYNC while operational. TPDOs of type 1..240 go out on every Nth SYNC whether or not their
+// values changed, type 0 on the first SYNC after a change. RPDO data held since the last SYNC is applied
+void processSyncPDOs(uint8_t nodeID) {
+  PdoNodeState& pdo = cmNode->pdo;
+  uint32_t now = millis();
+  for (uint16_t i = 0; i < CM_MAX_TPDOS; i++) {
+    const PdoComm& c = pdo.tpdoComm[i];
+    if (!c.enabled || !isSyncPDO(c)) continue;
+    if (c.trans_type == 0) {
+      if (tpdoChanged(i)) sendTPDO(nodeID, i, now);
       continue;
     }
-
-    twai_message_t tx{};
-    tx.identifier = tpdoComm[i].cob_id & 0x7FF;
-    tx.data_length_code = len;
-    tx.flags = TWAI_MSG_FLAG_NONE;
-    memcpy(tx.data, payload, len);
-
-    if (twai_transmit(&tx, pdMS_TO_TICKS(10)) == ESP_OK) {
-      tpdoState[i].last_tx_ms = now;
-      tpdoState[i].last_len = len;
-      memcpy(tpdoState[i].last_payload, payload, len);
-      tpdoState[i].last_valid = true;
-      tpdoDirty[i] = false;
-    } else {
-      sendEMCY(0x01, nodeID, 0x00000403); // TPDO transmission failed
+    if (++pdo.tpdoState[i].sync_count >= c.trans_type) {
+      pdo.tpdoState[i].sync_count = 0;
+      sendTPDO(nodeID, i, now);
+    }
+  }
+  for (uint16_t i = 0; i < CM_MAX_RPDOS; i++) {
+    if (!pdo.rpdoLatched[i]) continue;
+    pdo.rpdoLatched[i] = false;
+    if (!unpackRPDO(nodeID, i, pdo.rpdoLatch[i], pdo.rpdoLatchLen[i])) {
+      sendEMCY(0x01, nodeID, 0x00000404); // RPDO unpack failed
     }
   }
 }
 
 // Configures communication parameters for a TPDO channel
-void configureTPDO(uint8_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs, uint16_t eventMs) {
-  if (pdoNum < 4) {
-    setComm(tpdoComm[pdoNum], cobID, transType, inhibitMs, eventMs);
+void configureTPDO(uint16_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs, uint16_t eventMs) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum < CM_MAX_TPDOS) {
+    setComm(pdo.tpdoComm[pdoNum], cobID, transType, inhibitMs, eventMs);
+    pdo.tpdoState[pdoNum].sync_count = 0;
+    if (pdo.tpdoComm[pdoNum].enabled && pdo.tpdoWasOperational) schedulerArm(pdo.tpdoTimer[pdoNum], millis());
+    else schedulerDisarm(pdo.tpdoTimer[pdoNum]); // armed by serviceTPDOs() once operational
   }
 }
 
-// Configures communication parameters for an RPDO channel
-void configureRPDO(uint8_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs) {
-  if (pdoNum < 4) {
-    setComm(rpdoComm[pdoNum], cobID, transType, inhibitMs, 0); // RPDOs don’t
+// Picks when a TPDO is sent, takes effect from its next deadline
+void setTPDOSendMode(uint16_t pdoNum, TpdoSendMode mode) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_TPDOS) return;
+  pdo.tpdoSendMode[pdoNum] = mode;
+  if (pdo.tpdoComm[pdoNum].enabled && pdo.tpdoWasOperational) schedulerArm(pdo.tpdoTimer[pdoNum], millis());
+}
+
+// CiA 301 restricted COB-IDs (NMT, SDO, NMT error control, LSS) plus the SYNC and EMCY defaults, which no PDO may use
+static bool pdoCobIDRestricted(uint16_t cob) {
+  return cob <= 0x0FF || (cob >= 0x101 && cob <= 0x180) || (cob >= 0x581 && cob <= 0x5FF) ||
+         (cob >= 0x601 && cob <= 0x67F) || (cob >= 0x6E0 && cob <= 0x6FF) || cob >= 0x701;
+}
+
+// True when an RPDO may take cobID: not restricted and not already dispatched to anything but this RPDO
+static bool rpdoCobIDAvailable(uint16_t pdoNum, uint16_t cob) {
+  const PdoComm& c = cmNode->pdo.rpdoComm[pdoNum];
+  if (pdoCobIDRestricted(cob)) return false;
+  if (getCANDispatchKind(cob) == CAN_DISPATCH_NONE) return true;
+  return c.enabled && (c.cob_id & 0x7FF) == cob;
+}
+
+// Configures communication parameters for an RPDO channel, refuses a COB-ID another consumer already owns
+bool configureRPDO(uint16_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS) return false;
+  if ((cobID & 0x80000000u) == 0 && !rpdoCobIDAvailable(pdoNum, cobID & 0x7FF)) {
+    Serial.println("Error 0x00000406: RPDO COB-ID rejected");
+    return false;
   }
+  // Move the dispatch entry from the old COB-ID to the new one
+  uint16_t oldCob = pdo.rpdoComm[pdoNum].cob_id & 0x7FF;
+  if (pdo.rpdoComm[pdoNum].enabled && getCANDispatchKind(oldCob) == CAN_DISPATCH_RPDO) clearCANDispatch(oldCob);
+  setComm(pdo.rpdoComm[pdoNum], cobID, transType, inhibitMs, 0); // RPDOs don’t
+  pdo.rpdoLatched[pdoNum] = false;
+  if (pdo.rpdoComm[pdoNum].enabled) setCANDispatch(cobID & 0x7FF, CAN_DISPATCH_RPDO, pdoNum);
+  return true;
 }
 
 // Maps object dictionary entries to a TPDO channel
-bool mapTPDO(uint8_t pdoNum, const PdoMapEntry* entries, uint8_t count) {
-  if (pdoNum >= 4 || count > 8) return false;
-  tpdoMap[pdoNum].count = count;
-  memcpy(tpdoMap[pdoNum].e, entries, count * sizeof(PdoMapEntry));
+bool mapTPDO(uint16_t pdoNum, const PdoMapEntry* entries, uint8_t count) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_TPDOS || count > CM_PDO_MAX_ENTRIES) return false;
+  PdoPlan plan;
+  if (!buildPlan(entries, count, false, plan)) {
+    Serial.println("Error 0x00000401: TPDO mapping rejected");
+    return false;
+  }
+  pdo.tpdoMap[pdoNum].count = count;
+  memcpy(pdo.tpdoMap[pdoNum].e, entries, count * sizeof(PdoMapEntry));
+  pdo.tpdoPlan[pdoNum] = plan;
+  pdo.tpdoState[pdoNum].last_valid = false;
+  rebuildTpdoSources();
   return true;
 }
 
 // Maps object dictionary entries to an RPDO channel
-bool mapRPDO(uint8_t pdoNum, const PdoMapEntry* entries, uint8_t count) {
-  if (pdoNum >= 4 || count > 8) return false;
-  rpdoMap[pdoNum].count = count;
-  memcpy(rpdoMap[pdoNum].e, entries, count * sizeof(PdoMapEntry));
+bool mapRPDO(uint16_t pdoNum, const PdoMapEntry* entries, uint8_t count) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS || count > CM_PDO_MAX_ENTRIES) return false;
+  PdoPlan plan;
+  if (!buildPlan(entries, count, true, plan)) {
+    Serial.println("Error 0x00000402: RPDO mapping rejected");
+    return false;
+  }
+  pdo.rpdoMap[pdoNum].count = count;
+  memcpy(pdo.rpdoMap[pdoNum].e, entries, count * sizeof(PdoMapEntry));
+  flagTpdoSources(plan);
+  beginRpdoPlanWrite(pdo, pdoNum);
+  pdo.rpdoPlan[pdoNum] = plan;
+  endRpdoPlanWrite(pdo, pdoNum);
+  pdo.rpdoMonitor[pdoNum].has_safe = false; // laid out for the old mapping
+  return true;
+}
+
+void setRPDOTimeout(uint16_t pdoNum, uint16_t timeoutMs, RpdoTimeoutCallback callback) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS) return;
+  RpdoMonitor& m = pdo.rpdoMonitor[pdoNum];
+  m.timeout_ms = timeoutMs;
+  m.callback = callback;
+  if (timeoutMs == 0) schedulerDisarm(m.timer);
+  else if (pdo.tpdoWasOperational) schedulerArm(m.timer, (m.received ? m.last_rx_ms : millis()) + timeoutMs);
+}
+
+bool setRPDOSafeDefaults(uint16_t pdoNum) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS || pdo.rpdoPlan[pdoNum].count == 0) return false;
+  RpdoMonitor& m = pdo.rpdoMonitor[pdoNum];
+  memset(m.safe_payload, 0, sizeof(m.safe_payload));
+  packPlan(pdo.rpdoPlan[pdoNum], m.safe_payload);
+  m.has_safe = true;
   return true;
 }
 
+uint32_t getRPDOAge(uint16_t pdoNum) {
+  if (pdoNum >= CM_MAX_RPDOS || !cmNode->pdo.rpdoMonitor[pdoNum].received) return UINT32_MAX;
+  return millis() - cmNode->pdo.rpdoMonitor[pdoNum].last_rx_ms;
+}
+
+bool isRPDOFresh(uint16_t pdoNum) {
+  if (pdoNum >= CM_MAX_RPDOS) return false;
+  return cmNode->pdo.rpdoMonitor[pdoNum].received && !cmNode->pdo.rpdoMonitor[pdoNum].expired;
+}
+
+// Switch before the node goes operational, frames already waiting in a snapshot are dropped
+void setRPDOBuffered(uint16_t pdoNum, bool buffered) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS) return;
+  seqlockReset(pdo.rpdoSnapshot[pdoNum]);
+  pdo.rpdoSnapshotTaken[pdoNum] = 0;
+  pdo.rpdoBuffered[pdoNum] = buffered;
+}
+
+bool takeRPDOSnapshot(uint16_t pdoNum) {
+  PdoNodeState& pdo = cmNode->pdo;
+  if (pdoNum >= CM_MAX_RPDOS || !pdo.rpdoBuffered[pdoNum]) return false;
+  uint8_t data[8];
+  uint8_t len;
+  uint32_t frameMapping;
+  uint32_t seq = seqlockRead(pdo.rpdoSnapshot[pdoNum], data, &len, &frameMapping);
+  if (seq == 0 || seq == pdo.rpdoSnapshotTaken[pdoNum]) return false;
+  pdo.rpdoSnapshotTaken[pdoNum] = seq;
+
+  // Copy the plan, handleCAN() may be remapping the RPDO (over SDO) at the same time. The copy is only used if
+  // no rewrite started or finished while it was taken, and only for a frame received under that same mapping
+  uint32_t before = pdo.rpdoPlanSeq[pdoNum].load(std::memory_order_acquire);
+  if ((before & 1) || before != frameMapping) return false;
+  PdoPlan p;
+  const PdoPlan& shared = pdo.rpdoPlan[pdoNum];
+  p.count = shared.count < CM_PDO_MAX_ENTRIES ? shared.count : CM_PDO_MAX_ENTRIES;
+  p.totalLen = shared.totalLen;
+  p.bitPacked = shared.bitPacked;
+  memcpy(p.e, shared.e, p.count * sizeof(PdoPlanEntry));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (pdo.rpdoPlanSeq[pdoNum].load(std::memory_order_relaxed) != before) return false;
+
+  if (p.totalLen != len) return false;
+  unpackPlan(p, data);
+  return true;
+}
+
+// --- Communication and mapping objects ---
+
+enum PdoObjectKind : uint8_t { PDO_OBJ_RPDO_COMM, PDO_OBJ_RPDO_MAP, PDO_OBJ_TPDO_COMM, PDO_OBJ_TPDO_MAP };
+
+// Splits a 0x1400-0x1BFF index into its kind and channel, false outside that range or past the last channel
+static bool decodePdoObject(uint16_t index, uint8_t* kind, uint16_t* pdoNum) {
+  if (index < 0x1400 || index > 0x1BFF) return false;
+  *kind = (index - 0x1400) >> 9;
+  *pdoNum = index & 0x1FF;
+  return *pdoNum < (*kind <= PDO_OBJ_RPDO_MAP ? CM_MAX_RPDOS : CM_MAX_TPDOS);
+}
+
+bool readPDOObject(uint16_t index, uint8_t subindex, uint32_t* value, uint8_t* size) {
+  PdoNodeState& pdo = cmNode->pdo;
+  uint8_t kind;
+  uint16_t n;
+  if (!decodePdoObject(index, &kind, &n)) return false;
+
+  if (kind == PDO_OBJ_RPDO_COMM || kind == PDO_OBJ_TPDO_COMM) {
+    const PdoComm& c = kind == PDO_OBJ_RPDO_COMM ? pdo.rpdoComm[n] : pdo.tpdoComm[n];
+    switch (subindex) {
+      case 0: *value = 5; *size = 1; return true; // highest subindex
+      case 1: *value = c.cob_id; *size = 4; return true;
+      case 2: *value = c.trans_type; *size = 1; return true;
+      case 3: // ms inside, 100 µs units on the object
+        *value = c.inhibit_time * 10u > 0xFFFF ? 0xFFFF : c.inhibit_time * 10u;
+        *size = 2;
+        return true;
+      case 5:
+        *value = kind == PDO_OBJ_RPDO_COMM ? pdo.rpdoMonitor[n].timeout_ms : c.event_timer;
+        *size = 2;
+        return true;
+      default: return false;
+    }
+  }
+
+  const PdoMap& m = kind == PDO_OBJ_RPDO_MAP ? pdo.rpdoMap[n] : pdo.tpdoMap[n];
+  if (subindex == 0) {
+    *value = m.count;
+    *size = 1;
+    return true;
+  }
+  if (subindex > CM_PDO_MAX_ENTRIES) return false;
+  const PdoMapEntry& e = (pdo.stagedMapIndex == index ? pdo.stagedMap : m).e[subindex - 1];
+  *value = ((uint32_t)e.index << 16) | ((uint32_t)e.subindex << 8) | e.len_bits;
+  *size = 4;
+  return true;
+}
+
+// Sets the abort code for a rejected write, returns false so callers can return it
+static bool rejectPDOWrite(uint32_t* abortCode, uint32_t code) {
+  if (abortCode != nullptr) *abortCode = code;
+  return false;
+}
+
+bool writePDOObject(uint16_t index, uint8_t subindex, uint32_t value, uint32_t* abortCode) {
+  PdoNodeState& pdo = cmNode->pdo;
+  uint8_t kind;
+  uint16_t n;
+  if (!decodePdoObject(index, &kind, &n)) return rejectPDOWrite(abortCode, SDO_ABORT_PARAMETER);
+
+  if (kind == PDO_OBJ_RPDO_COMM || kind == PDO_OBJ_TPDO_COMM) {
+    PdoComm c = kind == PDO_OBJ_RPDO_COMM ? pdo.rpdoComm[n] : pdo.tpdoComm[n];
+    switch (subindex) {
+      case 1:
+        // 11-bit identifiers only, bit 31 disables the PDO and bit 30 (no RTR) is ignored
+        if (value & 0x3FFFF800u) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+        if ((value & 0x80000000u) == 0) {
+          uint16_t cob = value & 0x7FF;
+          bool ok = kind == PDO_OBJ_RPDO_COMM ? rpdoCobIDAvailable(n, cob) : !pdoCobIDRestricted(cob);
+          if (!ok) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+        }
+        c.cob_id = value;
+        break;
+      case 2:
+        if (value > 0xFF || (value > 240 && value < 252)) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+        c.trans_type = (uint8_t)value;
+        break;
+      case 3:
+        if (value > 0xFFFF) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+        c.inhibit_time = (uint16_t)((value + 9) / 10); // 100 µs units, never shorter than asked for
+        break;
+      case 5:
+        if (value > 0xFFFF) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+        if (kind == PDO_OBJ_RPDO_COMM) {
+          setRPDOTimeout(n, (uint16_t)value, pdo.rpdoMonitor[n].callback);
+          return true;
+        }
+        c.event_timer = (uint16_t)value;
+        break;
+      case 0:
+        return rejectPDOWrite(abortCode, SDO_ABORT_READ_ONLY);
+      default:
+        return rejectPDOWrite(abortCode, SDO_ABORT_PARAMETER);
+    }
+    // Same path as setup(), moves the dispatch entry and re-arms the timers
+    if (kind == PDO_OBJ_RPDO_COMM) configureRPDO(n, c.cob_id, c.trans_type, c.inhibit_time);
+    else configureTPDO(n, c.cob_id, c.trans_type, c.inhibit_time, c.event_timer);
+    return true;
+  }
+
+  PdoMap& m = kind == PDO_OBJ_RPDO_MAP ? pdo.rpdoMap[n] : pdo.tpdoMap[n];
+  if (subindex == 0) {
+    if (value > CM_PDO_MAX_ENTRIES) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+    // The staged entries if this object has some, otherwise the current ones again (e.g. after an OD change)
+    PdoMapEntry entries[CM_PDO_MAX_ENTRIES];
+    memcpy(entries, pdo.stagedMapIndex == index ? pdo.stagedMap.e : m.e, sizeof(entries));
+    bool ok = kind == PDO_OBJ_RPDO_MAP ? mapRPDO(n, entries, (uint8_t)value) : mapTPDO(n, entries, (uint8_t)value);
+    if (!ok) return rejectPDOWrite(abortCode, SDO_ABORT_PARAMETER);
+    pdo.stagedMapIndex = 0;
+    return true;
+  }
+  if (subindex > CM_PDO_MAX_ENTRIES) return rejectPDOWrite(abortCode, SDO_ABORT_PARAMETER);
+  if ((uint8_t)value == 0 || (uint8_t)value > 64) return rejectPDOWrite(abortCode, SDO_ABORT_VALUE);
+  if (pdo.stagedMapIndex != index) {
+    // One object is staged at a time, starting another drops what wasn't applied
+    pdo.stagedMap = m;
+    pdo.stagedMapIndex = index;
+  }
+  pdo.stagedMap.e[subindex - 1] = {(uint16_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+  return true;
+}
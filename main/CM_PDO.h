@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    18/08/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -16,10 +16,32 @@
 
 #include <Arduino.h>
 #include "driver/twai.h"
+#include "CM_Scheduler.h"
+#include "CM_Seqlock.h"
+
+// PDO channels per direction, up to the CiA 301 limit of 512. Every channel costs its state in each node, so
+// only raise these as far as a node needs. Each channel also takes a scheduler timer (CM_MAX_TIMERS)
+#ifndef CM_MAX_TPDOS
+#define CM_MAX_TPDOS 4
+#endif
+#ifndef CM_MAX_RPDOS
+#define CM_MAX_RPDOS 4
+#endif
+
+// Entries one PDO can map. 8 covers byte-sized values, raise it (up to 64) to pack single bit flags
+#ifndef CM_PDO_MAX_ENTRIES
+#define CM_PDO_MAX_ENTRIES 8
+#endif
+
+static_assert(CM_PDO_MAX_ENTRIES >= 1 && CM_PDO_MAX_ENTRIES <= 64, "CM_PDO_MAX_ENTRIES must be 1..64");
+static_assert(CM_MAX_TPDOS >= 1 && CM_MAX_TPDOS <= 512, "CM_MAX_TPDOS must be 1..512");
+static_assert(CM_MAX_RPDOS >= 1 && CM_MAX_RPDOS <= 512, "CM_MAX_RPDOS must be 1..512");
+static_assert(CM_MAX_TIMERS >= CM_MAX_TPDOS + CM_MAX_RPDOS + 3,
+              "CM_MAX_TIMERS must cover every TPDO and RPDO plus the heartbeat and SYNC timers");
 
 struct PdoComm {
   uint32_t cob_id;        // sub1
-  uint8_t  trans_type;    // sub2 (255 async; 0/1..240 sync types)
+  uint8_t  trans_type;    // sub2: 254/255 async, 0 on the SYNC after a change, 1..240 every Nth SYNC (CM_SYNC.h)
   uint16_t inhibit_time;  // sub3 in 100 µs units (CiA); we’ll store ms for simplicity
   uint16_t event_timer;   // sub5 in ms
   bool     enabled;       // derived from cob_id bit31 == 0
@@ -28,12 +50,38 @@ struct PdoComm {
 struct PdoMapEntry {
   uint16_t index;
   uint8_t  subindex;
-  uint8_t  len_bits;   // 8,16,32 for byte-aligned
+  uint8_t  len_bits;   // 1..64, fields follow each other bit by bit (8,16,32 keep them byte-aligned)
 };
 
 struct PdoMap {
   uint8_t count;
-  PdoMapEntry e[8];    // up to 8 entries (<= 64 bytes total for CAN FD, but we’ll cap to 8 bytes classic)
+  PdoMapEntry e[CM_PDO_MAX_ENTRIES];  // at most 64 bits in total, classic CAN
+};
+
+// Mapping resolved against the object dictionary when mapTPDO()/mapRPDO() is called
+struct PdoPlanEntry {
+  void*    dataPtr;    // OD variable the bytes are copied from/to
+  uint8_t  offset;     // byte offset in the CAN payload
+  uint8_t  len;        // bytes copied from/to the OD variable
+  uint8_t  shift;      // bit offset in the CAN payload
+  bool     feedsTpdo;  // RPDO only: a TPDO maps the same variable, see markTpdosMapping()
+  uint64_t mask;       // low len_bits bits set
+};
+
+struct PdoPlan {
+  uint8_t count;
+  uint8_t totalLen;    // payload length in bytes, always <= 8
+  bool    bitPacked;   // some field isn't whole bytes on a byte boundary, packed with shift/mask instead of memcpy
+  PdoPlanEntry e[CM_PDO_MAX_ENTRIES];
+};
+
+// When a TPDO is sent, set per channel with setTPDOSendMode()
+enum TpdoSendMode : uint8_t {
+  TPDO_SEND_SAMPLED = 0,         // default: mapped values are checked every ms (every loop) once the event timer has
+                                 // passed since the last send, and sent if they changed. Event timer 0 checks always
+  TPDO_SEND_ON_CHANGE,           // only when a mapped value is written through the OD (writeODEntry(), CmWatched,
+                                 // SDO, RPDO), nothing is checked while nothing is written
+  TPDO_SEND_ON_CHANGE_PERIODIC   // on change as above, plus every event timer period even if nothing changed
 };
 
 struct TpdoState {
@@ -42,29 +90,119 @@ struct TpdoState {
   uint8_t  last_payload[8];
   uint8_t  last_len;
   bool     last_valid;
+  uint8_t  sync_count;   // SYNCs since the last synchronous send
+};
+
+// An OD variable mapped into a TPDO, one per (variable, TPDO) pair, see markTpdosMapping()
+struct TpdoSource {
+  uintptr_t dataPtr;
+  uint16_t  pdoNum;
+};
+
+// Called once when an RPDO misses its deadline, after the safe defaults (if any) have been written
+typedef void (*RpdoTimeoutCallback)(uint8_t nodeID, uint16_t pdoNum);
+
+// Receive deadline of one RPDO, see setRPDOTimeout()
+struct RpdoMonitor {
+  uint32_t   last_rx_ms;      // millis() of the last valid frame
+  bool       received;        // a valid frame has arrived since the node went operational
+  bool       expired;         // deadline missed, cleared by the next valid frame
+  bool       has_safe;
+  uint8_t    safe_payload[8]; // written into the mapped entries on expiry, laid out like a received frame
+  uint16_t   timeout_ms;      // 0 = not monitored
+  RpdoTimeoutCallback callback;
+  SchedTimer timer;
+};
+
+// Per node PDO channels, owned by CanMrexNode (CM_Node.h)
+struct PdoNodeState {
+  PdoComm rpdoComm[CM_MAX_RPDOS];
+  PdoMap  rpdoMap[CM_MAX_RPDOS];
+  PdoPlan rpdoPlan[CM_MAX_RPDOS];
+  uint8_t rpdoLatch[CM_MAX_RPDOS][8];   // synchronous RPDO data waiting for the next SYNC
+  uint8_t rpdoLatchLen[CM_MAX_RPDOS];
+  bool    rpdoLatched[CM_MAX_RPDOS];
+  RpdoMonitor rpdoMonitor[CM_MAX_RPDOS];
+  bool       rpdoBuffered[CM_MAX_RPDOS];      // frames go to rpdoSnapshot, takeRPDOSnapshot() writes the variables
+  PdoSeqlock rpdoSnapshot[CM_MAX_RPDOS];
+  uint32_t   rpdoSnapshotTaken[CM_MAX_RPDOS];  // sequence of the last snapshot taken
+  std::atomic<uint32_t> rpdoPlanSeq[CM_MAX_RPDOS];  // odd while rpdoPlan is rewritten, frames are tagged with it
+
+  PdoComm tpdoComm[CM_MAX_TPDOS];
+  PdoMap  tpdoMap[CM_MAX_TPDOS];
+  PdoPlan tpdoPlan[CM_MAX_TPDOS];
+
+  TpdoState  tpdoState[CM_MAX_TPDOS];
+  bool       tpdoDirty[CM_MAX_TPDOS];
+  uint8_t    tpdoSendMode[CM_MAX_TPDOS];   // TpdoSendMode
+  SchedTimer tpdoTimer[CM_MAX_TPDOS];
+  bool       tpdoWasOperational;
+
+  TpdoSource tpdoSources[CM_MAX_TPDOS * CM_PDO_MAX_ENTRIES];  // sorted by address then TPDO, rebuilt by mapTPDO()
+  uint16_t   tpdoSourceCount;
+
+  // Mapping entries written over SDO (0x1600+n/0x1A00+n sub1..), applied when sub0 is written
+  uint16_t stagedMapIndex;  // object being staged, 0 = none
+  PdoMap   stagedMap;
 };
 
 void initDefaultPDOs(uint8_t nodeID);
 
 // Call in loop
-void processRPDO(const twai_message_t& rx, uint8_t nodeID);  // now includes nodeID
-void serviceTPDOs(uint8_t nodeID);  // handles periodic/event-driven sends
+void processRPDO(const twai_message_t& rx, uint8_t nodeID, uint16_t pdoNum);  // pdoNum comes from the dispatch table
+void serviceTPDOs(uint8_t nodeID);  // re-arms TPDO timers and RPDO deadlines on entering operational
+void processSyncPDOs(uint8_t nodeID);  // on SYNC: sends synchronous TPDOs that are due, applies latched RPDOs
 
 // Helpers
-bool packTPDO(uint8_t nodeID, uint8_t pdoNum, uint8_t* outBytes, uint8_t* outLen);  // now includes nodeID
-bool unpackRPDO(uint8_t nodeID, uint8_t pdoNum, const uint8_t* data, uint8_t len);  // now includes nodeID
+bool packTPDO(uint8_t nodeID, uint16_t pdoNum, uint8_t* outBytes, uint8_t* outLen);  // now includes nodeID
+bool unpackRPDO(uint8_t nodeID, uint16_t pdoNum, const uint8_t* data, uint8_t len);  // now includes nodeID
 
 // Optional: expose a simple API to trigger event-driven sends on change
-void markTpdoDirty(uint8_t pdoNum);
-
-// Communication setup
-void configureTPDO(uint8_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs, uint16_t eventMs);
-void configureRPDO(uint8_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs);
-
-
-// Mapping setup
-bool mapTPDO(uint8_t pdoNum, const PdoMapEntry* entries, uint8_t count);
-bool mapRPDO(uint8_t pdoNum, const PdoMapEntry* entries, uint8_t count);
+void markTpdoDirty(uint16_t pdoNum);
+
+// Marks every TPDO that maps the OD variable at dataPtr dirty. Called for writes through writeODEntry(),
+// CmWatched, SDO downloads and RPDOs, so user code doesn't have to know which TPDOs carry a value
+void markTpdosMapping(const void* dataPtr);
+
+// Communication setup. configureRPDO() refuses (returns false, nothing changes) a COB-ID that CiA 301 restricts or
+// that the node already receives on, e.g. NMT, SYNC, EMCY or its own SDO requests
+void configureTPDO(uint16_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs, uint16_t eventMs);
+bool configureRPDO(uint16_t pdoNum, uint32_t cobID, uint8_t transType, uint16_t inhibitMs);
+void setTPDOSendMode(uint16_t pdoNum, TpdoSendMode mode);
+
+// RPDO freshness. After timeoutMs without a valid frame (counted from entering operational until the first one)
+// the RPDO's safe defaults are written, a minor EMCY (0x00000405) is sent and callback runs. It fires once per
+// gap. 0 turns the deadline off
+void setRPDOTimeout(uint16_t pdoNum, uint16_t timeoutMs, RpdoTimeoutCallback callback = nullptr);
+// Remembers the current values of the RPDO's mapped variables as its safe defaults. Set the variables to safe
+// values and call it after mapRPDO(), a new mapping drops them
+bool setRPDOSafeDefaults(uint16_t pdoNum);
+uint32_t getRPDOAge(uint16_t pdoNum);  // ms since the last valid frame, UINT32_MAX if none yet
+bool isRPDOFresh(uint16_t pdoNum);     // false once the deadline has been missed, until the next frame
+
+// Buffered RPDOs, for when handleCAN runs in a different task or core than the code using the values. Frames
+// (and safe defaults) are kept in a lock-free seqlock instead of being written into the mapped variables, and
+// takeRPDOSnapshot(), called from the task that uses them, writes all fields of the latest frame at once.
+// Returns true if there was a frame it hadn't taken yet. Frames received under an older mapping, or a snapshot
+// that overlaps a remap, are skipped. TPDOs fed by the RPDO are marked when the frame arrives, by handleCAN()
+void setRPDOBuffered(uint16_t pdoNum, bool buffered);
+bool takeRPDOSnapshot(uint16_t pdoNum);
+
+
+// Mapping setup (OD entries must be registered first, returns false if the mapping is invalid)
+bool mapTPDO(uint16_t pdoNum, const PdoMapEntry* entries, uint8_t count);
+bool mapRPDO(uint16_t pdoNum, const PdoMapEntry* entries, uint8_t count);
+
+// Communication (0x1400+n RPDO, 0x1800+n TPDO) and mapping (0x1600+n, 0x1A00+n) parameters as CiA 301 objects,
+// reached through SDO and writeODEntry(). Comm sub1 COB-ID, sub2 transmission type, sub3 inhibit time (100 µs
+// units like CiA 301, rounded up to the ms kept in PdoComm), sub5 event timer (TPDO) or deadline (RPDO, see
+// setRPDOTimeout()), all applied straight away. Mapping sub1.. are (index << 16 | subindex << 8 | bits) and only
+// take effect when sub0 is written with the entry count, so a running PDO switches from the old mapping to the new
+// one in one step.
+// readPDOObject() returns false if the object doesn't exist, writePDOObject() also if the value is rejected, with
+// the SDO abort code for it in abortCode
+bool readPDOObject(uint16_t index, uint8_t subindex, uint32_t* value, uint8_t* size);
+bool writePDOObject(uint16_t index, uint8_t subindex, uint32_t value, uint32_t* abortCode = nullptr);
 
 
 #endif
\ No newline at end of file
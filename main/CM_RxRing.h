@@ -0,0 +1,74 @@
+/**
+ * CAN MREX Receive ring buffer file
+ *
+ * File:            CM_RxRing.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#ifndef CM_RX_RING_H
+#define CM_RX_RING_H
+
+#include <stdint.h>
+#include <atomic>
+#include "driver/twai.h"
+
+#ifndef CM_RX_RING_SIZE
+#define CM_RX_RING_SIZE 32  // Must be a power of two
+#endif
+
+static_assert((CM_RX_RING_SIZE & (CM_RX_RING_SIZE - 1)) == 0, "CM_RX_RING_SIZE must be a power of two");
+
+// Single producer (RX task) / single consumer (handleCAN) ring of received frames.
+// head and tail are free running counters, only the producer writes head and only the consumer writes tail.
+typedef struct {
+  twai_message_t buf[CM_RX_RING_SIZE];
+  std::atomic<uint16_t> head;
+  std::atomic<uint16_t> tail;
+  uint32_t dropped;  // frames lost because the ring was full (producer side)
+} CanRxRing;
+
+inline void rxRingReset(CanRxRing& r) {
+  r.head.store(0, std::memory_order_relaxed);
+  r.tail.store(0, std::memory_order_relaxed);
+  r.dropped = 0;
+}
+
+inline uint16_t rxRingCount(const CanRxRing& r) {
+  return (uint16_t)(r.head.load(std::memory_order_acquire) - r.tail.load(std::memory_order_acquire));
+}
+
+inline bool rxRingEmpty(const CanRxRing& r) {
+  return rxRingCount(r) == 0;
+}
+
+inline bool rxRingFull(const CanRxRing& r) {
+  return rxRingCount(r) >= CM_RX_RING_SIZE;
+}
+
+// Producer side, returns false (and counts a drop) if the ring is full
+inline bool rxRingPush(CanRxRing& r, const twai_message_t& msg) {
+  uint16_t head = r.head.load(std::memory_order_relaxed);
+  if ((uint16_t)(head - r.tail.load(std::memory_order_acquire)) >= CM_RX_RING_SIZE) {
+    r.dropped++;
+    return false;
+  }
+  r.buf[head & (CM_RX_RING_SIZE - 1)] = msg;
+  r.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// Consumer side, returns false if the ring is empty
+inline bool rxRingPop(CanRxRing& r, twai_message_t& msg) {
+  uint16_t tail = r.tail.load(std::memory_order_relaxed);
+  if (tail == r.head.load(std::memory_order_acquire)) return false;
+  msg = r.buf[tail & (CM_RX_RING_SIZE - 1)];
+  r.tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+#endif
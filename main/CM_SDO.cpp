@@ -6,7 +6,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    30/09/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -17,9 +17,345 @@
 #include "CM_SDO.h"
 #include "CM_ObjectDictionary.h"
 #include "CM_EMCY.h"
+#include "CM_Config.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
+#include "CM_PDO.h"
+
+// Expedited upload response for an object of 1-4 bytes (scs 2, e and s set, n unused bytes), 0 for other sizes
+static uint8_t sdoUploadCmd(uint16_t size) {
+  return (size >= 1 && size <= 4) ? 0x43 | ((4 - size) << 2) : 0;
+}
+
+// Bytes carried by an expedited download request (ccs 1, e and s set), 0 if cmd isn't one
+static uint8_t sdoDownloadSize(uint8_t cmd) {
+  return (cmd & 0xE3) == 0x23 ? 4 - ((cmd >> 2) & 0x03) : 0;
+}
+
+static void fillSDOAbort(uint8_t* data, uint16_t index, uint8_t subindex, uint32_t code) {
+  data[0] = 0x80;
+  data[1] = index & 0xFF;
+  data[2] = (index >> 8) & 0xFF;
+  data[3] = subindex;
+  memcpy(&data[4], &code, 4);
+}
+
+static void sendSDOResponse(const twai_message_t& txMsg, uint8_t nodeID) {
+  if (!queueCANTx(txMsg, CAN_TX_SDO)) {
+    Serial.println("Error 0x00000005: Failed to transmit SDO response");
+    sendEMCY(0x01, nodeID, 0x00000005);
+  }
+}
+
+// --- Block transfers ---
+// Shared by the server and the client, the sender and receiver steps are the same in both directions.
+// Segments are copied straight from/into the object, nothing is buffered per block
+
+typedef enum : uint8_t {
+  BLOCK_SEGMENT_WAIT = 0,  // more segments to come in this block
+  BLOCK_SEGMENT_ACK,       // end of the block, acknowledge it
+  BLOCK_SEGMENT_LAST,      // last segment of the transfer taken, acknowledge it then wait for the end
+  BLOCK_SEGMENT_TOO_LONG,
+  BLOCK_SEGMENT_TOO_SHORT
+} BlockSegmentResult;
+
+// CiA 301 block CRC: CRC-16-CCITT, polynomial 0x1021, starting at 0
+static uint16_t sdoBlockCrc(uint16_t crc, const uint8_t* data, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static uint8_t sdoBlockSize() {
+  uint8_t segments = cmNode->sdo.blockSize;
+  return segments != 0 ? segments : SDO_BLOCK_SIZE;
+}
+
+bool setSDOBlockSize(uint8_t segments) {
+  if (segments < 1 || segments > 127) return false;
+  cmNode->sdo.blockSize = segments;
+  return true;
+}
+
+// Bytes in the segment starting at offset, 7 except for the last one
+static uint8_t blockSegmentLength(uint16_t size, uint32_t offset) {
+  return size - offset > 7 ? 7 : size - offset;
+}
+
+// Sender: fills data with the next segment of the current block. Returns false once the block, or the
+// object, has been sent
+static bool nextBlockSegment(SdoBlockState& b, uint8_t* data, const uint8_t* object, uint16_t size, uint16_t offset) {
+  uint32_t at = offset + (uint32_t)b.seq * 7;
+  if (b.seq >= b.blockSize || at >= size) return false;
+  uint8_t len = blockSegmentLength(size, at);
+  memset(data, 0, 8);
+  data[0] = (at + len == size ? 0x80 : 0x00) | (b.seq + 1);
+  memcpy(&data[1], object + at, len);
+  if (b.crc && at == b.crcOffset) {
+    b.crcValue = sdoBlockCrc(b.crcValue, object + at, len);
+    b.crcOffset += len;
+  }
+  b.seq++;
+  return true;
+}
+
+// Sender: takes the receiver's acknowledgement, segments after ackseq are sent again in the next block.
+// Returns true once the whole object has been acknowledged
+static bool takeBlockAck(SdoBlockState& b, const uint8_t* data, uint16_t& offset, uint16_t size) {
+  uint8_t acked = data[1] <= b.seq ? data[1] : b.seq;
+  uint32_t end = offset + (uint32_t)acked * 7;
+  offset = end > size ? size : end;
+  b.seq = 0;
+  b.blockSize = data[2];
+  return offset == size;
+}
+
+// Sender: end request (the same command byte from either side) with the unused bytes of the last segment
+static void fillBlockEnd(const SdoBlockState& b, uint8_t* data, uint16_t size) {
+  uint8_t lastLen = size - ((size - 1) / 7) * 7;
+  memset(data, 0, 8);
+  data[0] = 0xC1 | ((7 - lastLen) << 2);
+  data[1] = b.crcValue & 0xFF;
+  data[2] = b.crcValue >> 8;
+}
+
+// Receiver: takes the segment in data if it is the next one in order. Out of order segments are dropped,
+// the acknowledgement makes the sender repeat them
+static BlockSegmentResult receiveBlockSegment(SdoBlockState& b, const uint8_t* data, uint8_t* object, uint16_t size,
+                                              uint16_t offset) {
+  uint8_t seq = data[0] & 0x7F;
+  bool last = data[0] & 0x80;
+  if (seq == b.seq + 1) {
+    uint32_t at = offset + (uint32_t)b.seq * 7;
+    if (at >= size) return BLOCK_SEGMENT_TOO_LONG;
+    if (last && size - at > 7) return BLOCK_SEGMENT_TOO_SHORT;
+    uint8_t len = blockSegmentLength(size, at);
+    memcpy(object + at, &data[1], len);
+    if (b.crc) b.crcValue = sdoBlockCrc(b.crcValue, &data[1], len);
+    b.seq++;
+    if (last) {
+      b.endUnused = 7 - len;
+      return BLOCK_SEGMENT_LAST;
+    }
+  }
+  return (last || seq == b.blockSize) ? BLOCK_SEGMENT_ACK : BLOCK_SEGMENT_WAIT;
+}
+
+// Receiver: acknowledgement of the segments taken in order (the same command byte from either side), the next
+// block starts after them
+static void ackBlock(SdoBlockState& b, uint8_t* data, uint16_t& offset, uint16_t size) {
+  memset(data, 0, 8);
+  data[0] = 0xA2;
+  data[1] = b.seq;
+  data[2] = b.blockSize;
+  uint32_t end = offset + (uint32_t)b.seq * 7;
+  offset = end > size ? size : end;
+  b.seq = 0;
+}
+
+// Receiver: checks the end request against what arrived, returns the abort code or 0
+static uint32_t checkBlockEnd(const SdoBlockState& b, const uint8_t* data) {
+  if (((data[0] >> 2) & 0x07) != b.endUnused) return SDO_ABORT_LENGTH;
+  if (b.crc && (uint16_t)(data[1] | (data[2] << 8)) != b.crcValue) return SDO_ABORT_CRC;
+  return 0;
+}
+
+// Ends the server's segmented or block transfer and tells the client why
+static void abortServerTransfer(twai_message_t& txMsg, uint8_t nodeID, uint32_t code) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  srv.state = SDO_SERVER_IDLE;
+  fillSDOAbort(txMsg.data, srv.index, srv.subindex, code);
+  sendSDOResponse(txMsg, nodeID);
+}
 
+// Upload segment request: the next 7 bytes go straight from the OD variable into the response
+static void handleUploadSegment(const twai_message_t& rxMsg, uint8_t nodeID, twai_message_t& txMsg) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  uint8_t toggle = (rxMsg.data[0] >> 4) & 0x01;
+  if (srv.state != SDO_SERVER_UPLOADING) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_COMMAND);
+    return;
+  }
+  if (toggle != srv.toggle) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOGGLE);
+    return;
+  }
+
+  uint16_t len = srv.size - srv.offset;
+  if (len > 7) len = 7;
+  bool last = srv.offset + len == srv.size;
+  txMsg.data[0] = (toggle << 4) | ((7 - len) << 1) | (last ? 0x01 : 0x00);
+  memset(&txMsg.data[1], 0, 7);
+  memcpy(&txMsg.data[1], srv.dataPtr + srv.offset, len);
+  srv.offset += len;
+  srv.toggle ^= 1;
+  if (last) srv.state = SDO_SERVER_IDLE;
+  sendSDOResponse(txMsg, nodeID);
+}
+
+// Download segment: the received bytes go straight into the OD variable, TPDOs are marked once it is complete
+static void handleDownloadSegment(const twai_message_t& rxMsg, uint8_t nodeID, twai_message_t& txMsg) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  uint8_t cmd = rxMsg.data[0];
+  uint8_t toggle = (cmd >> 4) & 0x01;
+  if (srv.state != SDO_SERVER_DOWNLOADING) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_COMMAND);
+    return;
+  }
+  if (toggle != srv.toggle) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOGGLE);
+    return;
+  }
+
+  uint8_t len = 7 - ((cmd >> 1) & 0x07);
+  if (srv.offset + len > srv.size) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOO_LONG);
+    return;
+  }
+  memcpy(srv.dataPtr + srv.offset, &rxMsg.data[1], len);
+  srv.offset += len;
+  if (cmd & 0x01) { // last segment
+    if (srv.offset != srv.size) {
+      abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOO_SHORT);
+      return;
+    }
+    markTpdosMapping(srv.dataPtr);
+    srv.state = SDO_SERVER_IDLE;
+  }
+  txMsg.data[0] = 0x20 | (toggle << 4);
+  memset(&txMsg.data[1], 0, 7);
+  srv.toggle ^= 1;
+  sendSDOResponse(txMsg, nodeID);
+}
+
+// During a block download every frame from the client but an abort is a segment
+static void handleBlockDownloadSegment(const twai_message_t& rxMsg, uint8_t nodeID, twai_message_t& txMsg) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  switch (receiveBlockSegment(srv.blk, rxMsg.data, srv.dataPtr, srv.size, srv.offset)) {
+    case BLOCK_SEGMENT_WAIT:
+      return;
+    case BLOCK_SEGMENT_TOO_LONG:
+      abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOO_LONG);
+      return;
+    case BLOCK_SEGMENT_TOO_SHORT:
+      abortServerTransfer(txMsg, nodeID, SDO_ABORT_TOO_SHORT);
+      return;
+    case BLOCK_SEGMENT_LAST:
+      srv.state = SDO_SERVER_BLOCK_DOWNLOAD_END;
+      break;
+    case BLOCK_SEGMENT_ACK:
+      break;
+  }
+  ackBlock(srv.blk, txMsg.data, srv.offset, srv.size);
+  sendSDOResponse(txMsg, nodeID);
+}
+
+// Block download end request, TPDOs are marked once the length and CRC check out
+static void handleBlockDownloadEnd(const twai_message_t& rxMsg, uint8_t nodeID, twai_message_t& txMsg) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  if (srv.state != SDO_SERVER_BLOCK_DOWNLOAD_END) {
+    abortServerTransfer(txMsg, nodeID, SDO_ABORT_COMMAND);
+    return;
+  }
+  uint32_t code = checkBlockEnd(srv.blk, rxMsg.data);
+  if (code != 0) {
+    abortServerTransfer(txMsg, nodeID, code);
+    return;
+  }
+  markTpdosMapping(srv.dataPtr);
+  srv.state = SDO_SERVER_IDLE;
+  memset(txMsg.data, 0, 8);
+  txMsg.data[0] = 0xA1;
+  sendSDOResponse(txMsg, nodeID);
+}
+
+// Block upload requests after the initiate: start, block acknowledgement and end response
+static void handleBlockUploadRequest(const twai_message_t& rxMsg, uint8_t nodeID, twai_message_t& txMsg) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  uint8_t cs = rxMsg.data[0] & 0x03;
+  if (cs == 3 && srv.state == SDO_SERVER_BLOCK_UPLOAD_START) {
+    srv.state = SDO_SERVER_BLOCK_UPLOADING;
+    serviceSDOServer(nodeID);
+    return;
+  }
+  if (cs == 2 && srv.state == SDO_SERVER_BLOCK_UPLOADING) {
+    if (rxMsg.data[2] < 1 || rxMsg.data[2] > 127) {
+      abortServerTransfer(txMsg, nodeID, SDO_ABORT_BLOCK_SIZE);
+      return;
+    }
+    if (!takeBlockAck(srv.blk, rxMsg.data, srv.offset, srv.size)) {
+      serviceSDOServer(nodeID);
+      return;
+    }
+    fillBlockEnd(srv.blk, txMsg.data, srv.size);
+    srv.state = SDO_SERVER_BLOCK_UPLOAD_END;
+    sendSDOResponse(txMsg, nodeID);
+    return;
+  }
+  if (cs == 1 && srv.state == SDO_SERVER_BLOCK_UPLOAD_END) {
+    srv.state = SDO_SERVER_IDLE;
+    return;
+  }
+  abortServerTransfer(txMsg, nodeID, SDO_ABORT_COMMAND);
+}
+
+// Sends the segments of the current upload block as far as the transmit queue allows, keeping a slot free for
+// the node's other SDO responses. Called again from handleCAN() once the queue drains
+void serviceSDOServer(uint8_t nodeID) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
+  if (srv.state != SDO_SERVER_BLOCK_UPLOADING) return;
+  twai_message_t txMsg;
+  txMsg.identifier = 0x580 + nodeID;
+  txMsg.data_length_code = 8;
+  txMsg.flags = TWAI_MSG_FLAG_NONE;
+  while (getCANTxSpace(CAN_TX_SDO) > 1 && nextBlockSegment(srv.blk, txMsg.data, srv.dataPtr, srv.size, srv.offset)) {
+    sendSDOResponse(txMsg, nodeID);
+  }
+}
+
+// Serves the PDO communication/mapping objects, which the PDO module applies instead of the OD storing them.
+// Returns false if index/subindex isn't one of them
+static bool handlePDOObjectSDO(const twai_message_t& rxMsg, uint16_t index, uint8_t subindex, uint8_t nodeID,
+                               twai_message_t& txMsg) {
+  uint32_t value;
+  uint8_t size;
+  if (!readPDOObject(index, subindex, &value, &size)) return false;
+
+  uint8_t cmd = rxMsg.data[0];
+  if (cmd == 0x40) {
+    txMsg.data[0] = sdoUploadCmd(size);
+    memcpy(&txMsg.data[4], &value, size);
+    sendSDOResponse(txMsg, nodeID);
+    return true;
+  }
+  // Every rejection is answered with an abort so the client doesn't wait for its timeout
+  uint8_t expectedSize = sdoDownloadSize(cmd);
+  uint32_t abortCode = 0;
+  if (expectedSize == 0) {
+    Serial.println("Error 0x00000003: Unexpected SDO write command");
+    sendEMCY(0x01, nodeID, 0x00000003);
+    abortCode = SDO_ABORT_COMMAND;
+  } else if (expectedSize != size) {
+    Serial.println("Error 0x00000004: SDO size mismatch with OD entry");
+    sendEMCY(0x01, nodeID, 0x00000004);
+    abortCode = SDO_ABORT_LENGTH;
+  } else {
+    value = 0;
+    memcpy(&value, &rxMsg.data[4], size);
+    writePDOObject(index, subindex, value, &abortCode);
+  }
+  if (abortCode == 0) txMsg.data[0] = 0x60; // Write confirmation
+  else fillSDOAbort(txMsg.data, index, subindex, abortCode);
+  sendSDOResponse(txMsg, nodeID);
+  return true;
+}
 
 void handleSDO(const twai_message_t& rxMsg, uint8_t nodeID) {
+  SdoServerTransfer& srv = cmNode->sdo.server;
   uint16_t index = rxMsg.data[1] | (rxMsg.data[2] << 8);
   uint8_t subindex = rxMsg.data[3];
   uint8_t cmd = rxMsg.data[0];
@@ -37,172 +373,633 @@ void handleSDO(const twai_message_t& rxMsg, uint8_t nodeID) {
   txMsg.data[6] = 0;
   txMsg.data[7] = 0;
 
+  // Segments carry no index, they continue the transfer in progress
+  if (srv.state == SDO_SERVER_BLOCK_DOWNLOADING && cmd != 0x80) {
+    handleBlockDownloadSegment(rxMsg, nodeID, txMsg);
+    return;
+  }
+  switch (cmd >> 5) {
+    case 0: handleDownloadSegment(rxMsg, nodeID, txMsg); return;
+    case 3: handleUploadSegment(rxMsg, nodeID, txMsg); return;
+    case 4: srv.state = SDO_SERVER_IDLE; return; // abort from the client
+    case 5:
+      if (cmd & 0x03) { // block upload start, acknowledgement or end, only cs 0 starts a new transfer
+        handleBlockUploadRequest(rxMsg, nodeID, txMsg);
+        return;
+      }
+      break;
+    case 6:
+      if (cmd & 0x01) { // block download end
+        handleBlockDownloadEnd(rxMsg, nodeID, txMsg);
+        return;
+      }
+      break;
+  }
+  srv.state = SDO_SERVER_IDLE; // a new request replaces one the client gave up on
+
+  if (handlePDOObjectSDO(rxMsg, index, subindex, nodeID, txMsg)) return;
+
   //lookup OD entry
-  ODEntry* entry = findODEntry(index, subindex);
+  const ODEntry* entry = findODEntry(index, subindex);
   if (entry == nullptr) {
     Serial.println("Error 0x00000001: OD entry not found");
     sendEMCY(0x01, nodeID, 0x00000001);
+    fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_NO_OBJECT);
+    sendSDOResponse(txMsg, nodeID);
     return;
   }
 
 
   if (cmd == 0x40) { // --- Read request ---
-    // Set correct response command byte based on size
-    switch (entry->size) {
-      case 1: txMsg.data[0] = 0x4F; break;
-      case 2: txMsg.data[0] = 0x4B; break;
-      case 4: txMsg.data[0] = 0x43; break;
-      default:
+    if (entry->size > 4) {
+      // Segmented: announce the size, the client then asks for the data 7 bytes at a time
+      uint32_t size = entry->size;
+      txMsg.data[0] = 0x41;
+      memcpy(&txMsg.data[4], &size, 4);
+      srv = {SDO_SERVER_UPLOADING, 0, index, subindex, (uint8_t*)entry->dataPtr, entry->size, 0, {}};
+    } else {
+      // Set correct response command byte based on size
+      txMsg.data[0] = sdoUploadCmd(entry->size);
+      if (txMsg.data[0] == 0) {
         Serial.println("Error 0x00000002: OD entry size unsupported");
         sendEMCY(0x01, nodeID, 0x00000002);
+        fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_LENGTH);
+        sendSDOResponse(txMsg, nodeID);
         return;
+      }
+      memcpy(&txMsg.data[4], entry->dataPtr, entry->size);
     }
+  }
 
-    memcpy(&txMsg.data[4], entry->dataPtr, entry->size);
+  else if ((cmd & 0xE3) == 0xA0) { // --- block read request ---
+    uint8_t segments = rxMsg.data[4];
+    if (segments < 1 || segments > 127) {
+      fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_BLOCK_SIZE);
+      sendSDOResponse(txMsg, nodeID);
+      return;
+    }
+    // Size indicated, CRC if the client asked for it. Segments follow once the client starts the upload
+    uint32_t size = entry->size;
+    bool crc = cmd & 0x04;
+    txMsg.data[0] = 0xC2 | (crc ? 0x04 : 0x00);
+    memcpy(&txMsg.data[4], &size, 4);
+    srv = {SDO_SERVER_BLOCK_UPLOAD_START, 0, index, subindex, (uint8_t*)entry->dataPtr, entry->size, 0,
+           {crc, segments, 0, 0, 0, 0}};
+  }
+
+  else if ((cmd & 0xE1) == 0xC0) { // --- block write request ---
+    uint32_t size = entry->size;
+    if (cmd & 0x02) memcpy(&size, &rxMsg.data[4], 4); // size indicated
+    if (size != entry->size) {
+      Serial.println("Error 0x00000004: SDO size mismatch with OD entry");
+      sendEMCY(0x01, nodeID, 0x00000004);
+      fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_LENGTH);
+      sendSDOResponse(txMsg, nodeID);
+      return;
+    }
+    bool crc = cmd & 0x04;
+    txMsg.data[0] = 0xA0 | (crc ? 0x04 : 0x00);
+    txMsg.data[4] = sdoBlockSize();
+    srv = {SDO_SERVER_BLOCK_DOWNLOADING, 0, index, subindex, (uint8_t*)entry->dataPtr, entry->size, 0,
+           {crc, txMsg.data[4], 0, 0, 0, 0}};
+  }
+
+  else if ((cmd & 0xE2) == 0x20) { // --- segmented write request ---
+    uint32_t size = entry->size;
+    if (cmd & 0x01) memcpy(&size, &rxMsg.data[4], 4); // size indicated
+    if (size != entry->size) {
+      Serial.println("Error 0x00000004: SDO size mismatch with OD entry");
+      sendEMCY(0x01, nodeID, 0x00000004);
+      fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_LENGTH);
+      sendSDOResponse(txMsg, nodeID);
+      return;
+    }
+    txMsg.data[0] = 0x60;
+    srv = {SDO_SERVER_DOWNLOADING, 0, index, subindex, (uint8_t*)entry->dataPtr, entry->size, 0, {}};
   }
 
   else {  // --- write request ---
     // Determine expected write size from command byte
-    uint8_t expectedSize = 0;
-    switch(cmd) {
-      case 0x2F: expectedSize = 1; break;
-      case 0x2B: expectedSize = 2; break;
-      case 0x23: expectedSize = 4; break;
-      default:
-        Serial.println("Error 0x00000003: Unexpected SDO write command");
-        sendEMCY(0x01, nodeID, 0x00000003);
-        return;
+    uint8_t expectedSize = sdoDownloadSize(cmd);
+    if (expectedSize == 0) {
+      Serial.println("Error 0x00000003: Unexpected SDO write command");
+      sendEMCY(0x01, nodeID, 0x00000003);
+      fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_COMMAND);
+      sendSDOResponse(txMsg, nodeID);
+      return;
     }
 
     //Copy into the OD
     if (expectedSize == entry->size) {
       memcpy(entry->dataPtr, &rxMsg.data[4], expectedSize);
+      markTpdosMapping(entry->dataPtr);
       txMsg.data[0] = 0x60; // Write confirmation
     } else {
       Serial.println("Error 0x00000004: SDO size mismatch with OD entry");
       sendEMCY(0x01, nodeID, 0x00000004);
+      fillSDOAbort(txMsg.data, index, subindex, SDO_ABORT_LENGTH);
+      sendSDOResponse(txMsg, nodeID);
       return;
     }
   }
 
   // Send the response 
-  if (twai_transmit(&txMsg, pdMS_TO_TICKS(10)) != ESP_OK) {
-    Serial.println("Error 0x00000005: Failed to transmit SDO response");
-    sendEMCY(0x01, nodeID, 0x00000005);
+  sendSDOResponse(txMsg, nodeID);
+}
+
+
+
+// --- Client ---
+// One transaction can be in flight per target node. Responses are routed here by the dispatch table with the
+// slot as the channel. Handles carry the slot in the low bits and a sequence number above it
+#define SDO_HANDLE_SLOT_BITS 5
+
+static_assert(SDO_MAX_CLIENT_TRANSFERS <= (1 << SDO_HANDLE_SLOT_BITS), "SDO_MAX_CLIENT_TRANSFERS too large");
+
+// Completes a transaction and reports it to the callback
+static void finishSDO(SdoTransfer& t, SdoStatus status, uint32_t value) {
+  clearCANDispatch(0x580 + t.targetNodeID);
+  t.status = status;
+  t.value = value;
+  if (t.callback != nullptr) {
+    t.callback(t.handle, status, value);
   }
 }
 
+// Picks a free slot, round robin so finished results stay pollable for as long as possible
+static int8_t allocSDOSlot() {
+  SdoNodeState& sdo = cmNode->sdo;
+  for (uint8_t n = 0; n < SDO_MAX_CLIENT_TRANSFERS; n++) {
+    uint8_t slot = (sdo.nextSdoSlot + n) % SDO_MAX_CLIENT_TRANSFERS;
+    if (sdo.sdoClients[slot].status != SDO_PENDING) {
+      sdo.nextSdoSlot = (slot + 1) % SDO_MAX_CLIENT_TRANSFERS;
+      return slot;
+    }
+  }
+  return -1;
+}
 
+// Sends a prepared request and starts tracking it, returns SDO_INVALID_HANDLE if the target is busy,
+// every slot is in use or the transmit failed. buffer/size are the caller's data for a segmented transfer
+static SdoHandle submitSDO(uint8_t nodeID, uint8_t targetNodeID, const uint8_t* data, uint32_t timeoutMs, SdoCallback callback,
+                           uint8_t* buffer = nullptr, uint16_t size = 0) {
+  SdoNodeState& sdo = cmNode->sdo;
+  if (getCANDispatchKind(0x580 + targetNodeID) == CAN_DISPATCH_SDO_CLIENT) {
+    Serial.println("Error 0x0000000B: SDO client busy");
+    return SDO_INVALID_HANDLE;
+  }
+  int8_t slot = allocSDOSlot();
+  if (slot < 0) {
+    Serial.println("Error 0x0000000B: SDO client busy");
+    return SDO_INVALID_HANDLE;
+  }
 
-void executeSDOWrite(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, size_t size, const void* value) {
-  uint8_t sdoBuf[8];
-  uint8_t cmd;
+  // Covered by CM_FILTER_SDO_RESPONSES, otherwise only noted for the next filter update so this never reinstalls
+  ensureCANFilterAccepts(0x580 + targetNodeID);
 
+  twai_message_t msg;
+  msg.identifier = 0x600 + targetNodeID;
+  msg.data_length_code = 8;
+  msg.flags = TWAI_MSG_FLAG_NONE;
+  memcpy(msg.data, data, 8);
 
-  switch (size) {
-    case 1: cmd = 0x2F; break;
-    case 2: cmd = 0x2B; break;
-    case 4: cmd = 0x23; break;
-    default:
-      Serial.println("Error 0x00000006: Invalid object size in executeSDOWrite");
-      sendEMCY(0x01, nodeID, 0x00000006);
-      return;
+  // Transmit SDO request
+  if (!queueCANTx(msg, CAN_TX_SDO)) {
+    Serial.println("Error 0x00000007: Failed to transmit SDO request");
+    sendEMCY(0x01, nodeID, 0x00000007);
+    return SDO_INVALID_HANDLE;
   }
 
-  prepareSDOTransmit(cmd, index, subindex, value, size, sdoBuf);
-  transmitSDO(nodeID, targetNodeID, sdoBuf, nullptr);
+  if (++sdo.sdoSequence >= (1 << (16 - SDO_HANDLE_SLOT_BITS))) sdo.sdoSequence = 1;
+  SdoHandle handle = (sdo.sdoSequence << SDO_HANDLE_SLOT_BITS) | slot;
+  uint16_t index = data[1] | (data[2] << 8);
+  bool isRead = data[0] == 0x40 || (data[0] & 0xE3) == 0xA0; // upload or block upload initiate
+  sdo.sdoClients[slot] = {handle, SDO_PENDING, targetNodeID, 0, millis(), timeoutMs, callback,
+                          SDO_PHASE_INITIATE, isRead, 0, index, data[3], buffer, size, 0, {}};
+  setCANDispatch(0x580 + targetNodeID, CAN_DISPATCH_SDO_CLIENT, slot);
+  return handle;
 }
 
-uint32_t executeSDORead(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex) {
+SdoHandle sdoWriteAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, size_t size, const void* value,
+                        uint32_t timeoutMs, SdoCallback callback) {
   uint8_t sdoBuf[8];
-  uint8_t cmd = 0x40;
-  uint32_t outValue = 0;
-  
 
-  prepareSDOTransmit(cmd, index, subindex, nullptr, 0, sdoBuf);
-  transmitSDO(nodeID, targetNodeID, sdoBuf, &outValue);
-  return outValue;
+  if (size == 0 || size > 0xFFFF) {
+    Serial.println("Error 0x00000006: Invalid object size in executeSDOWrite");
+    sendEMCY(0x01, nodeID, 0x00000006);
+    return SDO_INVALID_HANDLE;
+  }
+  if (size <= 4) { // expedited, n = unused bytes
+    prepareSDOTransmit(0x23 | ((4 - size) << 2), index, subindex, value, size, sdoBuf);
+    return submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback);
+  }
+
+  // Segmented, the initiate request carries the size and the segments are sent from value as they're confirmed
+  uint32_t total = size;
+  prepareSDOTransmit(0x21, index, subindex, &total, 4, sdoBuf);
+  return submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback, (uint8_t*)value, size);
 }
 
-//used to prepare the message being sent over SDO
-void prepareSDOTransmit(uint8_t cmd, uint16_t index, uint8_t subindex, const void* value, size_t size, uint8_t* outBuf) {
-  outBuf[0] = cmd;
-  outBuf[1] = index & 0xFF;
-  outBuf[2] = (index >> 8) & 0xFF;
-  outBuf[3] = subindex;
+SdoHandle sdoReadAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex,
+                       uint32_t timeoutMs, SdoCallback callback) {
+  uint8_t sdoBuf[8];
+  prepareSDOTransmit(0x40, index, subindex, nullptr, 0, sdoBuf);
+  return submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback);
+}
 
-  // Copy value into data[4..7]
-  memset(&outBuf[4], 0, 4); // Clear padding
-  if (value != nullptr && size > 0) {
-    memcpy(&outBuf[4], value, size);
+SdoHandle sdoReadBufferAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                             uint16_t bufferSize, uint32_t timeoutMs, SdoCallback callback) {
+  uint8_t sdoBuf[8];
+  prepareSDOTransmit(0x40, index, subindex, nullptr, 0, sdoBuf);
+  return submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback, (uint8_t*)buffer, bufferSize);
+}
+
+SdoHandle sdoBlockWriteAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, uint16_t size,
+                             const void* value, uint32_t timeoutMs, SdoCallback callback) {
+  uint8_t sdoBuf[8];
+  if (size == 0) {
+    Serial.println("Error 0x00000006: Invalid object size in executeSDOBlockWrite");
+    sendEMCY(0x01, nodeID, 0x00000006);
+    return SDO_INVALID_HANDLE;
   }
+  // Block download with CRC and the size indicated, the server picks the block size
+  uint32_t total = size;
+  prepareSDOTransmit(0xC6, index, subindex, &total, 4, sdoBuf);
+  return submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback, (uint8_t*)value, size);
 }
 
-void transmitSDO(uint8_t nodeID, uint8_t targetNodeID, uint8_t* data, uint32_t* outValue) { 
-  // Prepare SDO for transmit
+SdoHandle sdoBlockReadAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                            uint16_t bufferSize, uint32_t timeoutMs, SdoCallback callback) {
+  uint8_t sdoBuf[8];
+  // Block upload with CRC, no protocol switch threshold
+  uint8_t segments = sdoBlockSize();
+  prepareSDOTransmit(0xA4, index, subindex, &segments, 1, sdoBuf);
+  SdoHandle handle = submitSDO(nodeID, targetNodeID, sdoBuf, timeoutMs, callback, (uint8_t*)buffer, bufferSize);
+  if (handle != SDO_INVALID_HANDLE) {
+    cmNode->sdo.sdoClients[handle & ((1 << SDO_HANDLE_SLOT_BITS) - 1)].blk.blockSize = segments;
+  }
+  return handle;
+}
+
+// Returns the state of a request, outValue is filled in once a read is SDO_DONE
+SdoStatus sdoPoll(SdoHandle handle, uint32_t* outValue) {
+  SdoNodeState& sdo = cmNode->sdo;
+  if (handle == SDO_INVALID_HANDLE) return SDO_IDLE;
+  const SdoTransfer& t = sdo.sdoClients[handle & ((1 << SDO_HANDLE_SLOT_BITS) - 1)];
+  if (t.handle != handle) return SDO_IDLE;
+  if (t.status == SDO_DONE && outValue != nullptr) *outValue = t.value;
+  return t.status;
+}
+
+// Number of requests still waiting for a response
+uint8_t sdoPendingCount() {
+  SdoNodeState& sdo = cmNode->sdo;
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < SDO_MAX_CLIENT_TRANSFERS; i++) {
+    if (sdo.sdoClients[i].status == SDO_PENDING) count++;
+  }
+  return count;
+}
+
+static bool sendSDORequest(const SdoTransfer& t, const uint8_t* data, uint8_t nodeID) {
   twai_message_t msg;
-  msg.identifier = 0x600 + targetNodeID;
+  msg.identifier = 0x600 + t.targetNodeID;
   msg.data_length_code = 8;
   msg.flags = TWAI_MSG_FLAG_NONE;
   memcpy(msg.data, data, 8);
-
-  // Transmit SDO request
-  if (twai_transmit(&msg, pdMS_TO_TICKS(10)) != ESP_OK) {
+  if (!queueCANTx(msg, CAN_TX_SDO)) {
     Serial.println("Error 0x00000007: Failed to transmit SDO request");
     sendEMCY(0x01, nodeID, 0x00000007);
-    return;
+    return false;
   }
+  return true;
+}
 
-  waitSDOResponse(outValue, targetNodeID, nodeID);
+// Gives up on a transaction and tells the server, so it isn't left halfway through a segmented transfer
+static void abortClientTransfer(SdoTransfer& t, uint8_t nodeID, uint32_t code, SdoStatus status) {
+  uint8_t data[8];
+  fillSDOAbort(data, t.index, t.subindex, code);
+  sendSDORequest(t, data, nodeID);
+  finishSDO(t, status, code);
 }
 
-void waitSDOResponse(uint32_t* outValue, uint8_t targetNodeID, uint8_t nodeID){
-  // Wait for response
-  unsigned long start = millis();
-  twai_message_t response;
-  while (millis() - start < 200) { // try until timeout and ensure messages received before are handled
-    if (twai_receive(&response, pdMS_TO_TICKS(50)) != ESP_OK)
-      continue;
+// Next download segment, up to 7 bytes straight from the caller's buffer
+static void sendDownloadSegment(SdoTransfer& t, uint8_t nodeID) {
+  uint8_t data[8] = {0};
+  uint16_t len = t.size - t.offset;
+  if (len > 7) len = 7;
+  bool last = t.offset + len == t.size;
+  data[0] = (t.toggle << 4) | ((7 - len) << 1) | (last ? 0x01 : 0x00);
+  memcpy(&data[1], t.buffer + t.offset, len);
+  t.offset += len;
+  if (!sendSDORequest(t, data, nodeID)) finishSDO(t, SDO_ERROR, 0);
+}
 
-    if (response.identifier == 0x580 + targetNodeID) { // Received response
-      uint8_t cmd = response.data[0];
+static void requestUploadSegment(SdoTransfer& t, uint8_t nodeID) {
+  uint8_t data[8] = {0};
+  data[0] = 0x60 | (t.toggle << 4);
+  if (!sendSDORequest(t, data, nodeID)) finishSDO(t, SDO_ERROR, 0);
+}
 
-      if (cmd == 0x60) return; // SDO Confirmed
+static void handleSegmentResponse(SdoTransfer& t, const twai_message_t& response, uint8_t nodeID) {
+  uint8_t cmd = response.data[0];
+  uint8_t expectedScs = t.isRead ? 0x00 : 0x20; // upload / download segment response
+  if ((cmd & 0xE0) != expectedScs) {
+    Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+    abortClientTransfer(t, nodeID, SDO_ABORT_COMMAND, SDO_ERROR);
+    return;
+  }
+  if (((cmd >> 4) & 0x01) != t.toggle) {
+    Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+    abortClientTransfer(t, nodeID, SDO_ABORT_TOGGLE, SDO_ERROR);
+    return;
+  }
+
+  if (!t.isRead) {
+    if (t.offset == t.size) {
+      finishSDO(t, SDO_DONE, 0);
+      return;
+    }
+    t.toggle ^= 1;
+    sendDownloadSegment(t, nodeID);
+    return;
+  }
+
+  uint8_t len = 7 - ((cmd >> 1) & 0x07);
+  if (t.offset + len > t.size) {
+    Serial.println("Error 0x0000000C: SDO object bigger than the read buffer");
+    abortClientTransfer(t, nodeID, SDO_ABORT_TOO_LONG, SDO_ERROR);
+    return;
+  }
+  memcpy(t.buffer + t.offset, &response.data[1], len);
+  t.offset += len;
+  if (cmd & 0x01) { // last segment
+    finishSDO(t, SDO_DONE, t.offset);
+    return;
+  }
+  t.toggle ^= 1;
+  requestUploadSegment(t, nodeID);
+}
+
+// Sends the segments of the current download block as far as the transmit queue allows, keeping a slot free
+// for the node's other SDO requests. serviceSDOClient() carries on once the queue drains
+static void sendBlockSegments(SdoTransfer& t, uint8_t nodeID) {
+  uint8_t data[8];
+  while (getCANTxSpace(CAN_TX_SDO) > 1 && nextBlockSegment(t.blk, data, t.buffer, t.size, t.offset)) {
+    sendSDORequest(t, data, nodeID);
+    t.startMs = millis(); // the server only answers at the end of the block
+  }
+}
 
-      if (cmd == 0x80) {
-        Serial.println("Error 0x00000009: SDO Abort received");
-        sendEMCY(0x01, nodeID, 0x00000009);
+// Block read: segments, then the server's end request
+static void handleBlockUploadResponse(SdoTransfer& t, const twai_message_t& response, uint8_t nodeID) {
+  uint8_t data[8];
+  if (t.phase == SDO_PHASE_BLOCK) {
+    switch (receiveBlockSegment(t.blk, response.data, t.buffer, t.size, t.offset)) {
+      case BLOCK_SEGMENT_WAIT:
         return;
-      }
+      case BLOCK_SEGMENT_TOO_LONG:
+        abortClientTransfer(t, nodeID, SDO_ABORT_TOO_LONG, SDO_ERROR);
+        return;
+      case BLOCK_SEGMENT_TOO_SHORT:
+        abortClientTransfer(t, nodeID, SDO_ABORT_TOO_SHORT, SDO_ERROR);
+        return;
+      case BLOCK_SEGMENT_LAST:
+        t.phase = SDO_PHASE_BLOCK_END;
+        break;
+      case BLOCK_SEGMENT_ACK:
+        break;
+    }
+    ackBlock(t.blk, data, t.offset, t.size);
+    if (!sendSDORequest(t, data, nodeID)) finishSDO(t, SDO_ERROR, 0);
+    return;
+  }
+
+  if ((response.data[0] & 0xE3) != 0xC1) {
+    Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+    abortClientTransfer(t, nodeID, SDO_ABORT_COMMAND, SDO_ERROR);
+    return;
+  }
+  uint32_t code = checkBlockEnd(t.blk, response.data);
+  if (code != 0) {
+    abortClientTransfer(t, nodeID, code, SDO_ERROR);
+    return;
+  }
+  memset(data, 0, 8);
+  data[0] = 0xA1;
+  if (!sendSDORequest(t, data, nodeID)) {
+    finishSDO(t, SDO_ERROR, 0);
+    return;
+  }
+  finishSDO(t, SDO_DONE, t.offset);
+}
+
+// Block write: acknowledgements, then the server's end response
+static void handleBlockDownloadResponse(SdoTransfer& t, const twai_message_t& response, uint8_t nodeID) {
+  uint8_t cmd = response.data[0];
+  if (t.phase == SDO_PHASE_BLOCK_END && cmd == 0xA1) {
+    finishSDO(t, SDO_DONE, 0);
+    return;
+  }
+  if (t.phase != SDO_PHASE_BLOCK || cmd != 0xA2) {
+    Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+    abortClientTransfer(t, nodeID, SDO_ABORT_COMMAND, SDO_ERROR);
+    return;
+  }
+  if (response.data[2] < 1 || response.data[2] > 127) {
+    abortClientTransfer(t, nodeID, SDO_ABORT_BLOCK_SIZE, SDO_ERROR);
+    return;
+  }
+  if (!takeBlockAck(t.blk, response.data, t.offset, t.size)) {
+    sendBlockSegments(t, nodeID);
+    return;
+  }
+  uint8_t data[8];
+  fillBlockEnd(t.blk, data, t.size);
+  t.phase = SDO_PHASE_BLOCK_END;
+  if (!sendSDORequest(t, data, nodeID)) finishSDO(t, SDO_ERROR, 0);
+}
+
+// Handles a response from a server we have a transaction with (slot comes from the dispatch table)
+void handleSDOResponse(const twai_message_t& response, uint8_t nodeID, uint8_t slot) {
+  SdoNodeState& sdo = cmNode->sdo;
+  if (slot >= SDO_MAX_CLIENT_TRANSFERS) return;
+  SdoTransfer& t = sdo.sdoClients[slot];
+  if (t.status != SDO_PENDING || response.identifier != 0x580u + t.targetNodeID) return;
+  uint8_t cmd = response.data[0];
+
+  if (cmd == 0x80) {
+    Serial.println("Error 0x00000009: SDO Abort received");
+    sendEMCY(0x01, nodeID, 0x00000009);
+    uint32_t code;
+    memcpy(&code, &response.data[4], 4);
+    finishSDO(t, SDO_ABORTED, code);
+    return;
+  }
+
+  t.startMs = millis(); // the timeout applies to each request of a segmented transfer
+  if (t.phase == SDO_PHASE_SEGMENTS) {
+    handleSegmentResponse(t, response, nodeID);
+    return;
+  }
+  if (t.phase == SDO_PHASE_BLOCK || t.phase == SDO_PHASE_BLOCK_END) {
+    if (t.isRead) handleBlockUploadResponse(t, response, nodeID);
+    else handleBlockDownloadResponse(t, response, nodeID);
+    return;
+  }
+
+  if (!t.isRead && cmd == 0x60) { // SDO Confirmed
+    if (t.buffer == nullptr) {
+      finishSDO(t, SDO_DONE, 0);
+      return;
+    }
+    t.phase = SDO_PHASE_SEGMENTS;
+    sendDownloadSegment(t, nodeID);
+    return;
+  }
 
-      if (cmd == 0x4F || cmd == 0x4B || cmd == 0x43) { // SDO Read 1, 2, 4 bytes
-        int32_t value = 0;
-        switch (cmd) {
-          case 0x4F: value = response.data[4]; break;
-          case 0x4B: value = response.data[4] | (response.data[5] << 8); break;
-          case 0x43: value = response.data[4] | (response.data[5] << 8) |
-                            (response.data[6] << 16) | (response.data[7] << 24); break;
-        }
-
-        //Return value 
-        if (outValue != nullptr) {
-          *outValue = value;
-        }
+  if (t.isRead && (cmd & 0xE2) == 0x42) { // SDO Read 1-4 bytes, expedited
+    uint8_t len = (cmd & 0x01) ? 4 - ((cmd >> 2) & 0x03) : 4;
+    uint32_t value = 0;
+    memcpy(&value, &response.data[4], len);
+    if (t.buffer != nullptr) {
+      if (len > t.size) {
+        Serial.println("Error 0x0000000C: SDO object bigger than the read buffer");
+        finishSDO(t, SDO_ERROR, 0);
         return;
       }
+      memcpy(t.buffer, &response.data[4], len);
+      value = len;
+    }
+    finishSDO(t, SDO_DONE, value);
+    return;
+  }
 
-      sendEMCY(0x01, nodeID, 0x0000000A); // Unexpected SDO CMD received in response
-      Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+  if (!t.isRead && (cmd & 0xE3) == 0xA0 && t.buffer != nullptr) { // Block write accepted, data[4] is the block size
+    if (response.data[4] < 1 || response.data[4] > 127) {
+      abortClientTransfer(t, nodeID, SDO_ABORT_BLOCK_SIZE, SDO_ERROR);
       return;
+    }
+    t.blk = {(cmd & 0x04) != 0, response.data[4], 0, 0, 0, 0};
+    t.phase = SDO_PHASE_BLOCK;
+    sendBlockSegments(t, nodeID);
+    return;
+  }
 
+  if (t.isRead && (cmd & 0xE3) == 0xC2 && t.buffer != nullptr) { // Block read accepted, data[4..7] is the size
+    uint32_t size;
+    memcpy(&size, &response.data[4], 4);
+    if (size > t.size) {
+      Serial.println("Error 0x0000000C: SDO object bigger than the read buffer");
+      abortClientTransfer(t, nodeID, SDO_ABORT_TOO_LONG, SDO_ERROR);
+      return;
+    }
+    t.size = size;
+    t.blk.crc = cmd & 0x04;
+    t.phase = SDO_PHASE_BLOCK;
+    uint8_t data[8] = {0xA3}; // start the upload
+    if (!sendSDORequest(t, data, nodeID)) finishSDO(t, SDO_ERROR, 0);
+    return;
+  }
 
-
-    } else{ // handle messages that aren't the response 
-      handleCAN(nodeID, &response);   
+  if (t.isRead && (cmd & 0xE2) == 0x40) { // Segmented read, data[4..7] is the size if s is set
+    uint32_t size = 0;
+    if (cmd & 0x01) memcpy(&size, &response.data[4], 4);
+    if (t.buffer == nullptr || size > t.size) {
+      Serial.println("Error 0x0000000C: SDO object bigger than the read buffer");
+      abortClientTransfer(t, nodeID, SDO_ABORT_TOO_LONG, SDO_ERROR);
+      return;
     }
+    t.phase = SDO_PHASE_SEGMENTS;
+    requestUploadSegment(t, nodeID);
+    return;
   }
 
-  sendEMCY(0x00, nodeID, 0x00000008); // SDO response not received
-  Serial.println("Error 0x00000008: SDO response timeout");
+  sendEMCY(0x01, nodeID, 0x0000000A); // Unexpected SDO CMD received in response
+  Serial.println("Error 0x0000000A: Unexpected SDO command in response");
+  finishSDO(t, SDO_ERROR, 0);
+}
 
-}
\ No newline at end of file
+// Times out outstanding transactions, called from handleCAN()
+void serviceSDOClient(uint8_t nodeID) {
+  SdoNodeState& sdo = cmNode->sdo;
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < SDO_MAX_CLIENT_TRANSFERS; i++) {
+    SdoTransfer& t = sdo.sdoClients[i];
+    if (t.status != SDO_PENDING) continue;
+    if (t.phase == SDO_PHASE_BLOCK && !t.isRead) sendBlockSegments(t, nodeID);
+    if (now - t.startMs < t.timeoutMs) continue;
+    sendEMCY(0x00, nodeID, 0x00000008); // SDO response not received
+    Serial.println("Error 0x00000008: SDO response timeout");
+    if (t.phase != SDO_PHASE_INITIATE) abortClientTransfer(t, nodeID, SDO_ABORT_TIMEOUT, SDO_TIMEOUT);
+    else finishSDO(t, SDO_TIMEOUT, 0);
+  }
+}
+
+// --- Blocking client wrappers ---
+// These keep calling handleCANBatch() until the request finishes, don't call them from an SDO callback
+static void waitSDOComplete(SdoHandle handle, uint8_t nodeID, uint32_t* outValue) {
+  while (sdoPoll(handle, outValue) == SDO_PENDING) {
+    handleCANBatch(nodeID);
+    yield();
+  }
+}
+
+void executeSDOWrite(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, size_t size, const void* value) {
+  SdoHandle handle = sdoWriteAsync(nodeID, targetNodeID, index, subindex, size, value);
+  if (handle == SDO_INVALID_HANDLE) return;
+  waitSDOComplete(handle, nodeID, nullptr);
+}
+
+uint32_t executeSDORead(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex) {
+  uint32_t outValue = 0;
+  SdoHandle handle = sdoReadAsync(nodeID, targetNodeID, index, subindex);
+  if (handle == SDO_INVALID_HANDLE) return 0;
+  waitSDOComplete(handle, nodeID, &outValue);
+  return outValue;
+}
+
+uint16_t executeSDOReadBuffer(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                              uint16_t bufferSize) {
+  uint32_t outValue = 0;
+  SdoHandle handle = sdoReadBufferAsync(nodeID, targetNodeID, index, subindex, buffer, bufferSize);
+  if (handle == SDO_INVALID_HANDLE) return 0;
+  waitSDOComplete(handle, nodeID, &outValue);
+  return outValue;
+}
+
+void executeSDOBlockWrite(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, uint16_t size,
+                          const void* value) {
+  SdoHandle handle = sdoBlockWriteAsync(nodeID, targetNodeID, index, subindex, size, value);
+  if (handle == SDO_INVALID_HANDLE) return;
+  waitSDOComplete(handle, nodeID, nullptr);
+}
+
+uint16_t executeSDOBlockRead(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                             uint16_t bufferSize) {
+  uint32_t outValue = 0;
+  SdoHandle handle = sdoBlockReadAsync(nodeID, targetNodeID, index, subindex, buffer, bufferSize);
+  if (handle == SDO_INVALID_HANDLE) return 0;
+  waitSDOComplete(handle, nodeID, &outValue);
+  return outValue;
+}
+
+//used to prepare the message being sent over SDO
+void prepareSDOTransmit(uint8_t cmd, uint16_t index, uint8_t subindex, const void* value, size_t size, uint8_t* outBuf) {
+  outBuf[0] = cmd;
+  outBuf[1] = index & 0xFF;
+  outBuf[2] = (index >> 8) & 0xFF;
+  outBuf[3] = subindex;
+
+  // Copy value into data[4..7]
+  memset(&outBuf[4], 0, 4); // Clear padding
+  if (value != nullptr && size > 0) {
+    memcpy(&outBuf[4], value, size);
+  }
+}
+
+void transmitSDO(uint8_t nodeID, uint8_t targetNodeID, uint8_t* data, uint32_t* outValue) { 
+  SdoHandle handle = submitSDO(nodeID, targetNodeID, data, SDO_DEFAULT_TIMEOUT_MS, nullptr);
+  if (handle == SDO_INVALID_HANDLE) return;
+  waitSDOComplete(handle, nodeID, outValue);
+}
@@ -5,7 +5,7 @@
  * Organisation:    MREX
  * Author:          Chiara Gillam
  * Date Created:    30/09/2025
- * Last Modified:   15/10/2025
+ * Last Modified:   16/10/2026
  * Version:         1.11.0
  *
  */
@@ -14,12 +14,169 @@
 #ifndef CM_SDO_H
 #define CM_SDO_H
 
+#include <Arduino.h>
+#include "driver/twai.h"
 
+// CiA 301 abort codes
+#define SDO_ABORT_TOGGLE     0x05030000u  // toggle bit not alternated
+#define SDO_ABORT_TIMEOUT    0x05040000u  // SDO protocol timed out
+#define SDO_ABORT_COMMAND    0x05040001u  // command specifier not valid or unknown
+#define SDO_ABORT_BLOCK_SIZE 0x05040002u  // invalid block size
+#define SDO_ABORT_CRC        0x05040004u  // CRC error
+#define SDO_ABORT_READ_ONLY  0x06010002u  // attempt to write a read only object
+#define SDO_ABORT_NO_OBJECT  0x06020000u  // object does not exist in the object dictionary
+#define SDO_ABORT_PARAMETER  0x06040043u  // general parameter incompatibility
+#define SDO_ABORT_LENGTH     0x06070010u  // length of service parameter does not match
+#define SDO_ABORT_TOO_LONG   0x06070012u  // length of service parameter too high
+#define SDO_ABORT_TOO_SHORT  0x06070013u  // length of service parameter too low
+#define SDO_ABORT_VALUE      0x06090030u  // value range of parameter exceeded
+
+#ifndef SDO_DEFAULT_TIMEOUT_MS
+#define SDO_DEFAULT_TIMEOUT_MS 200
+#endif
+
+// Segments this node takes in one block transfer before it acknowledges them (1-127). Keep it below the
+// receive queue depth (CM_RX_RING_SIZE) so a block arriving between two handleCAN() calls isn't dropped.
+// setSDOBlockSize() changes it at runtime
+#ifndef SDO_BLOCK_SIZE
+#define SDO_BLOCK_SIZE 16
+#endif
+
+static_assert(SDO_BLOCK_SIZE >= 1 && SDO_BLOCK_SIZE <= 127, "SDO_BLOCK_SIZE must be 1..127");
+
+#ifndef SDO_MAX_CLIENT_TRANSFERS
+#define SDO_MAX_CLIENT_TRANSFERS 16  // Requests in flight at once, one per target node (max 32)
+#endif
+
+// Async client request state
+typedef enum : uint8_t {
+  SDO_IDLE = 0,   // unknown or stale handle
+  SDO_PENDING,
+  SDO_DONE,
+  SDO_ABORTED,
+  SDO_TIMEOUT,
+  SDO_ERROR
+} SdoStatus;
+
+typedef uint16_t SdoHandle;
+#define SDO_INVALID_HANDLE 0
+
+// Called from handleCAN() when a request finishes, value is the read result (0 for writes, the byte count for
+// sdoReadBufferAsync(), the abort code for SDO_ABORTED)
+typedef void (*SdoCallback)(SdoHandle handle, SdoStatus status, uint32_t value);
+
+// Where a transaction is in the CiA 301 exchange
+typedef enum : uint8_t {
+  SDO_PHASE_INITIATE = 0,  // waiting for the initiate response
+  SDO_PHASE_SEGMENTS,      // segmented transfer, waiting for a segment response
+  SDO_PHASE_BLOCK,         // block transfer, sending or receiving the segments of a block
+  SDO_PHASE_BLOCK_END      // block transfer, every byte acknowledged, waiting for the end
+} SdoPhase;
+
+// Progress of a block transfer, on either side
+typedef struct {
+  bool crc;            // both sides check the CRC
+  uint8_t blockSize;   // segments per block
+  uint8_t seq;         // segments of the current block sent, or received in order
+  uint8_t endUnused;   // receiver: unused bytes the end request has to report
+  uint16_t crcValue;
+  uint16_t crcOffset;  // sender: bytes folded into crcValue, so repeated segments aren't counted twice
+} SdoBlockState;
+
+typedef struct {
+  SdoHandle handle;
+  SdoStatus status;
+  uint8_t targetNodeID;
+  uint32_t value;
+  uint32_t startMs;    // restarted by every response, the timeout applies per request
+  uint32_t timeoutMs;
+  SdoCallback callback;
+  // Segmented transfers, the caller's buffer is read/written directly
+  SdoPhase phase;
+  bool isRead;
+  uint8_t toggle;
+  uint16_t index;
+  uint8_t subindex;
+  uint8_t* buffer;     // nullptr for a plain value read
+  uint16_t size;       // buffer size (read) or bytes to send (write), the object size once a block read starts
+  uint16_t offset;     // bytes done, for a block transfer the start of the current block
+  SdoBlockState blk;
+} SdoTransfer;
+
+// Segmented or block transfer the server is in the middle of, one at a time. A new request replaces it
+typedef enum : uint8_t {
+  SDO_SERVER_IDLE = 0,
+  SDO_SERVER_UPLOADING,
+  SDO_SERVER_DOWNLOADING,
+  SDO_SERVER_BLOCK_DOWNLOADING,    // receiving segments
+  SDO_SERVER_BLOCK_DOWNLOAD_END,   // last segment in, waiting for the end request
+  SDO_SERVER_BLOCK_UPLOAD_START,   // waiting for the client to start the upload
+  SDO_SERVER_BLOCK_UPLOADING,      // sending a block, or waiting for it to be acknowledged
+  SDO_SERVER_BLOCK_UPLOAD_END      // end request sent, waiting for the client's response
+} SdoServerState;
+
+typedef struct {
+  SdoServerState state;
+  uint8_t toggle;
+  uint16_t index;
+  uint8_t subindex;
+  uint8_t* dataPtr;    // the OD variable, segments are copied straight from/into it
+  uint16_t size;
+  uint16_t offset;     // bytes done, for a block transfer the start of the current block
+  SdoBlockState blk;
+} SdoServerTransfer;
+
+// Per node client and server state, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  SdoTransfer sdoClients[SDO_MAX_CLIENT_TRANSFERS];
+  uint16_t sdoSequence;
+  uint8_t nextSdoSlot;
+  SdoServerTransfer server;
+  uint8_t blockSize;   // setSDOBlockSize(), 0 = SDO_BLOCK_SIZE
+} SdoNodeState;
+
+// Server. Entries of 1-4 bytes are transferred expedited, bigger ones segmented, 7 bytes per frame, or in
+// blocks when the client asks for a block transfer
 void handleSDO(const twai_message_t& rxMsg, uint8_t nodeID);
+void serviceSDOServer(uint8_t nodeID);  // sends the segments of a block upload as the transmit queue drains
+bool setSDOBlockSize(uint8_t segments); // 1-127, see SDO_BLOCK_SIZE
+
+// Async client, submit then poll with sdoPoll() or wait for the callback.
+// Requests to different nodes run at the same time, a second request to a busy node is refused.
+// Writes of 1-4 bytes are expedited, bigger ones up to 65535 bytes are segmented and value must stay
+// valid until the request finishes
+SdoHandle sdoReadAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex,
+                       uint32_t timeoutMs = SDO_DEFAULT_TIMEOUT_MS, SdoCallback callback = nullptr);
+SdoHandle sdoWriteAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, size_t size, const void* value,
+                        uint32_t timeoutMs = SDO_DEFAULT_TIMEOUT_MS, SdoCallback callback = nullptr);
+// Reads an object of any size into buffer, which must stay valid until the request finishes. The result value
+// is the number of bytes received. Objects bigger than bufferSize are aborted with SDO_ERROR
+SdoHandle sdoReadBufferAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                             uint16_t bufferSize, uint32_t timeoutMs = SDO_DEFAULT_TIMEOUT_MS,
+                             SdoCallback callback = nullptr);
+// Block transfers (CiA 301 block mode with CRC) for big objects. Segments go out back to back and are
+// acknowledged once per block instead of one at a time. Same results as the segmented versions
+SdoHandle sdoBlockWriteAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, uint16_t size,
+                             const void* value, uint32_t timeoutMs = SDO_DEFAULT_TIMEOUT_MS,
+                             SdoCallback callback = nullptr);
+SdoHandle sdoBlockReadAsync(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                            uint16_t bufferSize, uint32_t timeoutMs = SDO_DEFAULT_TIMEOUT_MS,
+                            SdoCallback callback = nullptr);
+SdoStatus sdoPoll(SdoHandle handle, uint32_t* outValue = nullptr);
+uint8_t sdoPendingCount();
+void handleSDOResponse(const twai_message_t& response, uint8_t nodeID, uint8_t slot);
+void serviceSDOClient(uint8_t nodeID);  // timeouts, and the segments of block writes as the transmit queue drains
+
+// Blocking client
 void transmitSDO(uint8_t nodeID, uint8_t targetNodeID, uint8_t* data, uint32_t* outValue);
 void prepareSDOTransmit(uint8_t cmd, uint16_t index, uint8_t subindex, const void* value, size_t size, uint8_t* outBuf);
 void executeSDOWrite(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, size_t size, const void* value);
 uint32_t executeSDORead(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex);
-void waitSDOResponse(uint32_t* outValue, uint8_t targetNodeID, uint8_t nodeID);
+uint16_t executeSDOReadBuffer(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                              uint16_t bufferSize);  // returns the bytes read, 0 on failure
+void executeSDOBlockWrite(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, uint16_t size,
+                          const void* value);
+uint16_t executeSDOBlockRead(uint8_t nodeID, uint8_t targetNodeID, uint16_t index, uint8_t subindex, void* buffer,
+                             uint16_t bufferSize);  // returns the bytes read, 0 on failure
 
 #endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+/**
+ * CAN MREX SYNC file
+ *
+ * File:            CM_SYNC.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "CM_SYNC.h"
+#include "CM_PDO.h"
+#include "CM_EMCY.h"
+#include "CM_Handler.h"
+#include "CM_Scheduler.h"
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
+
+// Everything a node does on a SYNC, received or produced
+static void syncEvent(uint8_t nodeID) {
+  SyncNodeState& sync = cmNode->sync;
+  sync.count++;
+  sync.lastSyncMs = millis();
+  if (cmOperatingMode() == 0x01) processSyncPDOs(nodeID);
+  if (sync.callback != nullptr) sync.callback(nodeID, sync.count);
+}
+
+// Scheduler callback for the producer. SYNC shares the NMT transmit class so it isn't held up behind PDOs
+static void syncTimerFired(uint8_t nodeID, uint16_t arg, uint32_t now) {
+  SyncNodeState& sync = cmNode->sync;
+  if (sync.periodMs == 0) return;
+
+  twai_message_t txMsg{};
+  txMsg.identifier = SYNC_COB_ID;
+  txMsg.data_length_code = 0;
+  txMsg.flags = TWAI_MSG_FLAG_NONE;
+
+  if (queueCANTx(txMsg, CAN_TX_NMT)) {
+    syncEvent(nodeID);
+  } else {
+    sendEMCY(0x01, nodeID, 0x00000701); // SYNC transmission failed
+  }
+  schedulerArm(sync.timer, now + sync.periodMs); // fixed period, a missed SYNC isn't sent late
+}
+
+void initSYNC() {
+  SyncNodeState& sync = cmNode->sync;
+  sync.periodMs = 0;
+  sync.count = 0;
+  sync.lastSyncMs = 0;
+  sync.timer = SCHED_INVALID_TIMER;
+  setCANDispatch(SYNC_COB_ID, CAN_DISPATCH_SYNC);
+}
+
+void setupSyncProducer(uint16_t periodMs) {
+  SyncNodeState& sync = cmNode->sync;
+  sync.periodMs = periodMs;
+  if (periodMs == 0) {
+    if (sync.timer != SCHED_INVALID_TIMER) schedulerDisarm(sync.timer);
+    return;
+  }
+  if (sync.timer == SCHED_INVALID_TIMER) sync.timer = schedulerCreateTimer(syncTimerFired, 0);
+  schedulerArm(sync.timer, millis() + periodMs);
+}
+
+void setSyncCallback(SyncCallback callback) {
+  cmNode->sync.callback = callback;
+}
+
+uint32_t getSyncCount() {
+  return cmNode->sync.count;
+}
+
+void handleSYNC(const twai_message_t& rxMsg, uint8_t nodeID) {
+  syncEvent(nodeID);
+}
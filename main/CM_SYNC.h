@@ -0,0 +1,47 @@
+/**
+ * CAN MREX SYNC file
+ *
+ * File:            CM_SYNC.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ * One node (usually the NMT master) sends SYNC (COB-ID 0x080, no data) at a fixed period. On every SYNC each
+ * node sends its synchronous TPDOs and applies the synchronous RPDOs it received since the last one, so the
+ * whole train samples and actuates together instead of drifting with each node's loop() speed.
+ */
+
+#ifndef CM_SYNC_H
+#define CM_SYNC_H
+
+#include <Arduino.h>
+#include "driver/twai.h"
+#include "CM_Scheduler.h"
+
+#define SYNC_COB_ID 0x080
+
+// Runs after the node's synchronous PDOs have been handled for this SYNC
+typedef void (*SyncCallback)(uint8_t nodeID, uint32_t syncCount);
+
+// Per node SYNC state, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  uint16_t periodMs;      // 0 = not producing
+  uint32_t count;         // SYNCs seen (received or produced)
+  uint32_t lastSyncMs;
+  SchedTimer timer;       // SCHED_INVALID_TIMER until setupSyncProducer()
+  SyncCallback callback;
+} SyncNodeState;
+
+void initSYNC();  // called from initCANMREX(), every node consumes SYNC
+
+// Starts sending SYNC every periodMs, 0 stops. The producer handles its own SYNC as well since a node
+// doesn't receive its own frames
+void setupSyncProducer(uint16_t periodMs);
+void setSyncCallback(SyncCallback callback);
+uint32_t getSyncCount();
+
+void handleSYNC(const twai_message_t& rxMsg, uint8_t nodeID);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * CAN MREX Scheduler file
+ *
+ * File:            CM_Scheduler.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "CM_Scheduler.h"
+#include "CM_Node.h"
+
+// millis() wraps, so compare deadlines by signed difference
+static inline bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static void heapSet(SchedulerNodeState& s, uint16_t pos, SchedTimer t) {
+  s.heap[pos] = t;
+  s.timers[t].heapPos = pos;
+}
+
+static void siftUp(SchedulerNodeState& s, uint16_t pos) {
+  SchedTimer t = s.heap[pos];
+  while (pos > 0) {
+    uint16_t parent = (pos - 1) / 2;
+    if (!before(s.timers[t].deadline, s.timers[s.heap[parent]].deadline)) break;
+    heapSet(s, pos, s.heap[parent]);
+    pos = parent;
+  }
+  heapSet(s, pos, t);
+}
+
+static void siftDown(SchedulerNodeState& s, uint16_t pos) {
+  SchedTimer t = s.heap[pos];
+  for (;;) {
+    uint16_t child = 2 * pos + 1;
+    if (child >= s.heapSize) break;
+    if (child + 1 < s.heapSize && before(s.timers[s.heap[child + 1]].deadline, s.timers[s.heap[child]].deadline)) child++;
+    if (!before(s.timers[s.heap[child]].deadline, s.timers[t].deadline)) break;
+    heapSet(s, pos, s.heap[child]);
+    pos = child;
+  }
+  heapSet(s, pos, t);
+}
+
+static void heapRemove(SchedulerNodeState& s, uint16_t pos) {
+  SchedTimer removed = s.heap[pos];
+  s.heapSize--;
+  if (pos < s.heapSize) {
+    SchedTimer moved = s.heap[s.heapSize];
+    heapSet(s, pos, moved);
+    siftDown(s, pos);
+    siftUp(s, s.timers[moved].heapPos);
+  }
+  s.timers[removed].heapPos = SCHED_INVALID_TIMER;
+}
+
+void resetScheduler() {
+  SchedulerNodeState& s = cmNode->sched;
+  s.timerCount = 0;
+  s.heapSize = 0;
+}
+
+SchedTimer schedulerCreateTimer(SchedCallback callback, uint16_t arg) {
+  SchedulerNodeState& s = cmNode->sched;
+  if (s.timerCount >= CM_MAX_TIMERS || callback == nullptr) return SCHED_INVALID_TIMER;
+  s.timers[s.timerCount] = {callback, arg, 0, SCHED_INVALID_TIMER};
+  return s.timerCount++;
+}
+
+void schedulerArm(SchedTimer timer, uint32_t deadline) {
+  SchedulerNodeState& s = cmNode->sched;
+  if (timer >= s.timerCount) return;
+  SchedEntry& e = s.timers[timer];
+  if (e.heapPos != SCHED_INVALID_TIMER) {
+    bool earlier = before(deadline, e.deadline);
+    e.deadline = deadline;
+    if (earlier) siftUp(s, e.heapPos);
+    else siftDown(s, e.heapPos);
+    return;
+  }
+  e.deadline = deadline;
+  heapSet(s, s.heapSize, timer);
+  s.heapSize++;
+  siftUp(s, e.heapPos);
+}
+
+void schedulerDisarm(SchedTimer timer) {
+  SchedulerNodeState& s = cmNode->sched;
+  if (timer >= s.timerCount || s.timers[timer].heapPos == SCHED_INVALID_TIMER) return;
+  heapRemove(s, s.timers[timer].heapPos);
+}
+
+bool schedulerArmed(SchedTimer timer) {
+  SchedulerNodeState& s = cmNode->sched;
+  return timer < s.timerCount && s.timers[timer].heapPos != SCHED_INVALID_TIMER;
+}
+
+bool schedulerNextDeadline(uint32_t* deadline) {
+  SchedulerNodeState& s = cmNode->sched;
+  if (s.heapSize == 0) return false;
+  *deadline = s.timers[s.heap[0]].deadline;
+  return true;
+}
+
+uint16_t runScheduler(uint8_t nodeID, uint32_t now) {
+  SchedulerNodeState& s = cmNode->sched;
+  uint16_t fired = 0;
+  // Each timer is popped before its callback runs, so the callback is free to re-arm it.
+  // The cap stops a timer that keeps re-arming itself at now from spinning forever
+  while (s.heapSize > 0 && !before(now, s.timers[s.heap[0]].deadline) && fired < CM_MAX_TIMERS) {
+    SchedTimer t = s.heap[0];
+    heapRemove(s, 0);
+    s.timers[t].callback(nodeID, s.timers[t].arg, now);
+    fired++;
+  }
+  return fired;
+}
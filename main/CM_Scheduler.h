@@ -0,0 +1,57 @@
+/**
+ * CAN MREX Scheduler file
+ *
+ * File:            CM_Scheduler.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#ifndef CM_SCHEDULER_H
+#define CM_SCHEDULER_H
+
+#include <stdint.h>
+
+#ifndef CM_MAX_TIMERS
+#define CM_MAX_TIMERS 16  // one per TPDO (CM_MAX_TPDOS), heartbeat, SYNC and other periodic services
+#endif
+
+static_assert(CM_MAX_TIMERS < 0xFFFF, "CM_MAX_TIMERS must fit a SchedTimer");
+
+typedef uint16_t SchedTimer;
+#define SCHED_INVALID_TIMER 0xFFFF
+
+// arg is whatever was given to schedulerCreateTimer() (e.g. the TPDO number), now is the time the scheduler ran
+typedef void (*SchedCallback)(uint8_t nodeID, uint16_t arg, uint32_t now);
+
+void resetScheduler();
+SchedTimer schedulerCreateTimer(SchedCallback callback, uint16_t arg);
+void schedulerArm(SchedTimer timer, uint32_t deadline);   // (re)schedules the timer, replaces any earlier deadline
+void schedulerDisarm(SchedTimer timer);
+bool schedulerArmed(SchedTimer timer);
+bool schedulerNextDeadline(uint32_t* deadline);            // false if nothing is armed
+
+// Runs every timer that is due at now, returns how many fired. Time is passed in so it can be driven by a simulated clock
+uint16_t runScheduler(uint8_t nodeID, uint32_t now);
+
+// Timers live in a fixed pool, armed timers are kept in a binary min-heap ordered by deadline.
+// Each timer remembers its heap position so it can be re-armed or removed in O(log n)
+typedef struct {
+  SchedCallback callback;
+  uint16_t arg;
+  uint32_t deadline;
+  uint16_t heapPos;  // SCHED_INVALID_TIMER when not armed
+} SchedEntry;
+
+// Per node scheduler state, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  SchedEntry timers[CM_MAX_TIMERS];
+  uint16_t timerCount;
+  SchedTimer heap[CM_MAX_TIMERS];
+  uint16_t heapSize;
+} SchedulerNodeState;
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * CAN MREX PDO snapshot seqlock file
+ *
+ * File:            CM_Seqlock.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#ifndef CM_SEQLOCK_H
+#define CM_SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Latest payload of one PDO, written by a single writer (the task running handleCAN) and read by any number
+// of readers. The writer never waits. A reader that overlapped a write copies again, so it always sees all
+// bytes of one frame. The payload is kept in atomic words so the copy is well defined while it races
+typedef struct {
+  std::atomic<uint32_t> seq;      // odd while a write is in progress, 0 until the first write
+  std::atomic<uint32_t> word[2];
+  std::atomic<uint8_t>  len;
+  std::atomic<uint32_t> tag;      // written with the payload, the caller's (PDO: the mapping it was received under)
+} PdoSeqlock;
+
+inline void seqlockReset(PdoSeqlock& s) {
+  s.seq.store(0, std::memory_order_relaxed);
+  s.word[0].store(0, std::memory_order_relaxed);
+  s.word[1].store(0, std::memory_order_relaxed);
+  s.len.store(0, std::memory_order_relaxed);
+  s.tag.store(0, std::memory_order_relaxed);
+}
+
+// Writer side, len is at most 8
+inline void seqlockWrite(PdoSeqlock& s, const uint8_t* data, uint8_t len, uint32_t tag = 0) {
+  uint32_t w[2] = {0, 0};
+  memcpy(w, data, len);
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  s.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.word[0].store(w[0], std::memory_order_relaxed);
+  s.word[1].store(w[1], std::memory_order_relaxed);
+  s.len.store(len, std::memory_order_relaxed);
+  s.tag.store(tag, std::memory_order_relaxed);
+  s.seq.store(seq + 2, std::memory_order_release);
+}
+
+// Reader side, copies the latest payload into data (8 bytes) and returns its sequence number, 0 if nothing
+// has been written yet. Two reads returning the same number saw the same frame
+inline uint32_t seqlockRead(const PdoSeqlock& s, uint8_t* data, uint8_t* len, uint32_t* tag = nullptr) {
+  uint32_t w[2];
+  uint8_t l;
+  uint32_t t;
+  uint32_t before, after;
+  do {
+    before = s.seq.load(std::memory_order_acquire);
+    w[0] = s.word[0].load(std::memory_order_relaxed);
+    w[1] = s.word[1].load(std::memory_order_relaxed);
+    l = s.len.load(std::memory_order_relaxed);
+    t = s.tag.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = s.seq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  memcpy(data, w, 8);
+  *len = l;
+  if (tag != nullptr) *tag = t;
+  return before;
+}
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * CAN MREX Transmit queue file
+ *
+ * File:            CM_TxQueue.cpp
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#include "CM_TxQueue.h"
+#include "CM_Node.h"
+
+static_assert((CM_TX_QUEUE_DEPTH & (CM_TX_QUEUE_DEPTH - 1)) == 0, "CM_TX_QUEUE_DEPTH must be a power of two");
+// head/tail are uint8_t, a full queue has to stay distinguishable from an empty one
+static_assert(CM_TX_QUEUE_DEPTH <= 128, "CM_TX_QUEUE_DEPTH must be at most 128");
+
+static inline uint8_t fifoCount(const TxFifo& q) {
+  return (uint8_t)(q.head - q.tail);
+}
+
+void resetCANTx() {
+  TxQueueNodeState& tx = cmNode->tx;
+  memset(tx.queues, 0, sizeof(tx.queues));
+  memset(&tx.stats, 0, sizeof(tx.stats));
+}
+
+// Hands as many frames as the driver will take, highest priority first
+uint8_t serviceCANTx() {
+  TxQueueNodeState& tx = cmNode->tx;
+  uint8_t fed = 0;
+  for (uint8_t c = 0; c < CAN_TX_CLASSES; c++) {
+    TxFifo& q = tx.queues[c];
+    while (fifoCount(q) > 0) {
+      uint8_t slot = q.tail & (CM_TX_QUEUE_DEPTH - 1);
+      if (twai_transmit(&q.buf[slot], 0) != ESP_OK) return fed; // driver full, try again later
+      uint32_t waited = micros() - q.queuedUs[slot];
+      if (waited > tx.stats.maxWaitUs[c]) tx.stats.maxWaitUs[c] = waited;
+      q.tail++;
+      tx.stats.depth[c]--;
+      tx.stats.sent++;
+      fed++;
+    }
+  }
+  return fed;
+}
+
+bool queueCANTx(const twai_message_t& msg, CanTxPriority priority) {
+  if (priority >= CAN_TX_CLASSES) return false;
+  TxQueueNodeState& tx = cmNode->tx;
+  TxFifo& q = tx.queues[priority];
+  if (fifoCount(q) >= CM_TX_QUEUE_DEPTH) {
+    tx.stats.dropped[priority]++;
+    return false;
+  }
+  q.buf[q.head & (CM_TX_QUEUE_DEPTH - 1)] = msg;
+  q.queuedUs[q.head & (CM_TX_QUEUE_DEPTH - 1)] = micros();
+  q.head++;
+  tx.stats.depth[priority]++;
+  if (tx.stats.depth[priority] > tx.stats.maxDepth[priority]) tx.stats.maxDepth[priority] = tx.stats.depth[priority];
+  serviceCANTx();
+  return true;
+}
+
+uint8_t getCANTxSpace(CanTxPriority priority) {
+  if (priority >= CAN_TX_CLASSES) return 0;
+  return CM_TX_QUEUE_DEPTH - fifoCount(cmNode->tx.queues[priority]);
+}
+
+CanTxStats getCANTxStats() {
+  return cmNode->tx.stats;
+}
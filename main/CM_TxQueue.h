@@ -0,0 +1,63 @@
+/**
+ * CAN MREX Transmit queue file
+ *
+ * File:            CM_TxQueue.h
+ * Organisation:    MREX
+ * Author:          Chiara Gillam
+ * Date Created:    16/10/2026
+ * Last Modified:   16/10/2026
+ * Version:         1.11.0
+ *
+ */
+
+#ifndef CM_TX_QUEUE_H
+#define CM_TX_QUEUE_H
+
+#include <Arduino.h>
+#include "driver/twai.h"
+
+#ifndef CM_TX_QUEUE_DEPTH
+#define CM_TX_QUEUE_DEPTH 8  // Frames per priority class, must be a power of two, at most 128
+#endif
+
+// Priority classes, lower value is sent first
+typedef enum : uint8_t {
+  CAN_TX_EMCY = 0,
+  CAN_TX_NMT,
+  CAN_TX_PDO,
+  CAN_TX_SDO,
+  CAN_TX_HEARTBEAT,
+  CAN_TX_CLASSES
+} CanTxPriority;
+
+typedef struct {
+  uint8_t  depth[CAN_TX_CLASSES];    // frames waiting right now
+  uint8_t  maxDepth[CAN_TX_CLASSES]; // high water mark
+  uint32_t dropped[CAN_TX_CLASSES];  // frames refused because the class was full
+  uint32_t maxWaitUs[CAN_TX_CLASSES];// longest a frame waited here before the driver took it
+  uint32_t sent;                     // frames handed to the driver
+} CanTxStats;
+
+// One FIFO per priority class. The driver queue is kept short (CM_TWAI_TX_QUEUE_LEN) so a frame
+// waiting here is never stuck behind more than a couple of lower priority frames already in hardware.
+// serviceCANTx() only runs from handleCAN(), so the loop rate caps how fast a node can send
+typedef struct {
+  twai_message_t buf[CM_TX_QUEUE_DEPTH];
+  uint32_t queuedUs[CM_TX_QUEUE_DEPTH];  // micros() when queued
+  uint8_t head;
+  uint8_t tail;
+} TxFifo;
+
+// Per node transmit state, owned by CanMrexNode (CM_Node.h)
+typedef struct {
+  TxFifo queues[CAN_TX_CLASSES];
+  CanTxStats stats;
+} TxQueueNodeState;
+
+void resetCANTx();
+bool queueCANTx(const twai_message_t& msg, CanTxPriority priority);  // never blocks, false if the frame was dropped
+uint8_t getCANTxSpace(CanTxPriority priority);                       // frames the class can still take
+uint8_t serviceCANTx();                                               // moves frames to the driver as slots free up
+CanTxStats getCANTxStats();
+
+#endif